@@ -0,0 +1,583 @@
+#pragma once
+
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/// @brief Settings of sqlite3_allocator
+struct sqlite3_allocator_options
+{
+    /// Free blocks of one size class kept by a thread before half of them go to the shared depot
+    size_t thread_cache_bytes = 256 * 1024;
+
+    /// Memory requested from malloc at once to carve blocks of one size class
+    size_t slab_bytes = 64 * 1024;
+
+    /// Chunk of the bump arena used inside arena_scope
+    size_t arena_chunk_bytes = 64 * 1024;
+
+    /// Larger allocations inside arena_scope go to size-class pools
+    size_t arena_max_allocation = 2048;
+
+    /// SQLITE_CONFIG_MEMSTATUS: with memory statistics every allocation takes a process-wide mutex,
+    /// disable to remove it, sqlite3_helper::stats() then reports zero process memory
+    bool memory_status = true;
+};
+
+/// @brief Allocator counters summed over all threads
+struct sqlite3_allocator_stats
+{
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+
+    /// Allocations served by size-class pools, by the bump arena and by malloc
+    uint64_t pool_allocations = 0;
+    uint64_t arena_allocations = 0;
+    uint64_t fallback_allocations = 0;
+
+    /// Thread cache refills from the shared depot and from new slabs
+    uint64_t depot_refills = 0;
+    uint64_t slab_refills = 0;
+
+    /// Thread cache overflows returned to the depot
+    uint64_t depot_returns = 0;
+
+    /// Arena chunks allocated
+    uint64_t arena_chunks = 0;
+
+    /// Bytes held by SQLite, including block rounding
+    int64_t bytes_in_use = 0;
+
+    /// Bytes requested from malloc for slabs, never returned until the process exits
+    uint64_t slab_bytes = 0;
+};
+
+/// @brief SQLite memory allocator replacing system malloc through SQLITE_CONFIG_MALLOC
+/// Small allocations are served from per-thread free lists of 19 size classes up to 8 KB,
+/// so threads do not contend in malloc; free lists are refilled in batches from a shared depot
+/// or from new slabs. Inside arena_scope, small allocations are bumped from a per-thread arena chunk,
+/// which is returned at once when all its allocations are freed, e.g. statement-lifetime memory
+/// of a prepare/step/finalize loop. Larger allocations go to malloc.
+/// Every block carries a 16-byte header, so blocks could be freed on any thread.
+/// Must be installed before sqlite3_initialize(), that is before the first connection is opened,
+/// or after sqlite3_shutdown()
+class sqlite3_allocator
+{
+public:
+
+    /// @brief Replace SQLite memory allocator, process-wide
+    /// @return: SQLite error code, SQLITE_MISUSE if SQLite is already initialized
+    static int install(const sqlite3_allocator_options& options = sqlite3_allocator_options())
+    {
+        global_state& state = global();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.installed) {
+            return SQLITE_MISUSE;
+        }
+        int return_code = sqlite3_config(SQLITE_CONFIG_GETMALLOC, &state.previous);
+        if (return_code != SQLITE_OK) {
+            return return_code;
+        }
+        state.options = options;
+        state.options.arena_max_allocation = std::min(options.arena_max_allocation, options.arena_chunk_bytes / 2);
+        static const sqlite3_mem_methods methods = {
+            &sqlite3_allocator::allocate,
+            &sqlite3_allocator::release,
+            &sqlite3_allocator::reallocate,
+            &sqlite3_allocator::size,
+            &sqlite3_allocator::roundup,
+            &sqlite3_allocator::init,
+            &sqlite3_allocator::shutdown,
+            nullptr
+        };
+        if ((return_code = sqlite3_config(SQLITE_CONFIG_MALLOC, &methods)) != SQLITE_OK) {
+            return return_code;
+        }
+        sqlite3_config(SQLITE_CONFIG_MEMSTATUS, options.memory_status ? 1 : 0);
+        state.installed = true;
+        return SQLITE_OK;
+    }
+
+    /// @brief Restore the allocator replaced by install(), after sqlite3_shutdown()
+    /// Blocks carry a header the restored allocator does not know, so all of them should be freed first,
+    /// that is all connections closed. Slabs are not returned to the system
+    /// @return: SQLite error code, SQLITE_MISUSE if SQLite is initialized,
+    /// SQLITE_BUSY while SQLite holds blocks of this allocator
+    static int uninstall()
+    {
+        global_state& state = global();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.installed) {
+            return SQLITE_MISUSE;
+        }
+        int64_t bytes_in_use = state.finished_threads.bytes_in_use;
+        for (const thread_cache* cache : state.caches) {
+            bytes_in_use += cache->counters.bytes_in_use.load(std::memory_order_relaxed);
+        }
+        if (bytes_in_use != 0) {
+            return SQLITE_BUSY;
+        }
+        const int return_code = sqlite3_config(SQLITE_CONFIG_MALLOC, &state.previous);
+        if (return_code == SQLITE_OK) {
+            sqlite3_config(SQLITE_CONFIG_MEMSTATUS, 1);
+            state.installed = false;
+        }
+        return return_code;
+    }
+
+    /// @brief Is the allocator installed
+    static bool is_installed()
+    {
+        global_state& state = global();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return state.installed;
+    }
+
+    /// @brief Counters summed over live and finished threads
+    static sqlite3_allocator_stats get_stats()
+    {
+        global_state& state = global();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        sqlite3_allocator_stats result = state.finished_threads;
+        for (const thread_cache* cache : state.caches) {
+            cache->counters.add_to(result);
+        }
+        result.slab_bytes = state.slab_bytes;
+        return result;
+    }
+
+private:
+
+    /// Block header, keeps payload 16-byte aligned
+    struct block_header
+    {
+        /// Size class index, fallback_tag, or address of the arena chunk
+        uint64_t tag;
+
+        /// Usable bytes of the payload
+        uint64_t capacity;
+    };
+
+    static constexpr size_t header_size = sizeof(block_header);
+    static constexpr uint64_t fallback_tag = ~uint64_t(0);
+    static constexpr size_t class_count = 19;
+
+    /// @brief Usable bytes of every size class
+    static size_t class_capacity(size_t index)
+    {
+        static const size_t capacities[class_count] = {
+            16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 5120, 6144, 8192
+        };
+        return capacities[index];
+    }
+
+    /// @return: class_count if the size is larger than the largest class
+    static size_t class_of(size_t bytes)
+    {
+        if (bytes <= 64) {
+            return (bytes <= 16) ? 0 : (bytes - 1) / 16;
+        }
+        size_t index = 4;
+        while (index < class_count && class_capacity(index) < bytes) {
+            ++index;
+        }
+        return index;
+    }
+
+    /// @brief Singly linked list of free blocks, linked through the payload
+    struct free_list
+    {
+        block_header* head = nullptr;
+        size_t count = 0;
+
+        void push(block_header* block)
+        {
+            std::memcpy(block + 1, &head, sizeof(head));
+            head = block;
+            ++count;
+        }
+
+        block_header* pop()
+        {
+            block_header* block = head;
+            std::memcpy(&head, block + 1, sizeof(head));
+            --count;
+            return block;
+        }
+    };
+
+    /// @brief Bump arena chunk, freed when the owner retired it and all blocks are freed
+    struct arena_chunk
+    {
+        /// Live blocks plus one while the chunk is current for its thread
+        std::atomic<int64_t> live{ 1 };
+        size_t used = 0;
+        size_t size = 0;
+    };
+
+    /// @brief Counters written only by the owner thread and read by get_stats()
+    struct thread_counters
+    {
+        std::atomic<uint64_t> allocations{ 0 };
+        std::atomic<uint64_t> frees{ 0 };
+        std::atomic<uint64_t> pool_allocations{ 0 };
+        std::atomic<uint64_t> arena_allocations{ 0 };
+        std::atomic<uint64_t> fallback_allocations{ 0 };
+        std::atomic<uint64_t> depot_refills{ 0 };
+        std::atomic<uint64_t> slab_refills{ 0 };
+        std::atomic<uint64_t> depot_returns{ 0 };
+        std::atomic<uint64_t> arena_chunks{ 0 };
+        std::atomic<int64_t> bytes_in_use{ 0 };
+
+        /// @brief Increment without a locked instruction, there is a single writer
+        template <typename T, typename Value>
+        static void add(std::atomic<T>& counter, Value value)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + static_cast<T>(value), std::memory_order_relaxed);
+        }
+
+        void add_to(sqlite3_allocator_stats& stats) const
+        {
+            stats.allocations += allocations.load(std::memory_order_relaxed);
+            stats.frees += frees.load(std::memory_order_relaxed);
+            stats.pool_allocations += pool_allocations.load(std::memory_order_relaxed);
+            stats.arena_allocations += arena_allocations.load(std::memory_order_relaxed);
+            stats.fallback_allocations += fallback_allocations.load(std::memory_order_relaxed);
+            stats.depot_refills += depot_refills.load(std::memory_order_relaxed);
+            stats.slab_refills += slab_refills.load(std::memory_order_relaxed);
+            stats.depot_returns += depot_returns.load(std::memory_order_relaxed);
+            stats.arena_chunks += arena_chunks.load(std::memory_order_relaxed);
+            stats.bytes_in_use += bytes_in_use.load(std::memory_order_relaxed);
+        }
+    };
+
+    /// @brief Per-thread free lists and arena
+    struct thread_cache
+    {
+        free_list lists[class_count];
+        arena_chunk* chunk = nullptr;
+        int arena_depth = 0;
+        thread_counters counters;
+    };
+
+    /// @brief Process-wide state, intentionally never destroyed as SQLite may free memory during exit
+    struct global_state
+    {
+        std::mutex mutex;
+        bool installed = false;
+        sqlite3_allocator_options options;
+        sqlite3_mem_methods previous = {};
+
+        /// Batches of free blocks of every size class, exchanged with thread caches
+        std::vector<free_list> depot[class_count];
+
+        std::vector<thread_cache*> caches;
+        sqlite3_allocator_stats finished_threads;
+        uint64_t slab_bytes = 0;
+    };
+
+    static global_state& global()
+    {
+        static global_state* state = new global_state();
+        return *state;
+    }
+
+    /// @brief Destroys the thread cache on thread exit
+    struct thread_cache_owner
+    {
+        thread_cache** cache;
+        bool* finished;
+
+        ~thread_cache_owner()
+        {
+            thread_cache* owned = *cache;
+            *cache = nullptr;
+            *finished = true;
+            retire_chunk(*owned);
+
+            global_state& state = global();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            for (size_t index = 0; index < class_count; ++index) {
+                if (owned->lists[index].count > 0) {
+                    state.depot[index].push_back(owned->lists[index]);
+                }
+            }
+            owned->counters.add_to(state.finished_threads);
+            state.caches.erase(std::remove(state.caches.begin(), state.caches.end(), owned), state.caches.end());
+            delete owned;
+        }
+    };
+
+    /// @return: cache of the current thread, nullptr while the thread is exiting
+    static thread_cache* current_cache()
+    {
+        // Trivially destructible, valid during the whole thread exit
+        thread_local thread_cache* cache = nullptr;
+        thread_local bool finished = false;
+        if (cache != nullptr || finished) {
+            return cache;
+        }
+        cache = new thread_cache();
+        {
+            global_state& state = global();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.caches.push_back(cache);
+        }
+        thread_local thread_cache_owner owner{ &cache, &finished };
+        return cache;
+    }
+
+    static void* payload(block_header* block)
+    {
+        return block + 1;
+    }
+
+    static block_header* header_of(void* memory)
+    {
+        return static_cast<block_header*>(memory) - 1;
+    }
+
+    /// @brief Take a batch from the depot, or carve a new slab
+    static bool refill(thread_cache& cache, size_t index)
+    {
+        global_state& state = global();
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (!state.depot[index].empty()) {
+                cache.lists[index] = state.depot[index].back();
+                state.depot[index].pop_back();
+                thread_counters::add(cache.counters.depot_refills, 1);
+                return true;
+            }
+        }
+
+        const size_t block_size = header_size + class_capacity(index);
+        const size_t slab_size = std::max(state.options.slab_bytes, block_size * 8);
+        char* slab = static_cast<char*>(std::malloc(slab_size));
+        if (slab == nullptr) {
+            return false;
+        }
+        for (size_t offset = 0; offset + block_size <= slab_size; offset += block_size) {
+            block_header* block = reinterpret_cast<block_header*>(slab + offset);
+            block->tag = index;
+            block->capacity = class_capacity(index);
+            cache.lists[index].push(block);
+        }
+        thread_counters::add(cache.counters.slab_refills, 1);
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.slab_bytes += slab_size;
+        return true;
+    }
+
+    /// @brief Give up the current chunk, it is freed with its last block
+    static void retire_chunk(thread_cache& cache)
+    {
+        if (cache.chunk != nullptr && cache.chunk->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            cache.chunk->~arena_chunk();
+            std::free(cache.chunk);
+        }
+        cache.chunk = nullptr;
+    }
+
+    static void* allocate_from_arena(thread_cache& cache, size_t bytes)
+    {
+        const size_t capacity = (bytes + 15) & ~size_t(15);
+        const size_t chunk_header = (sizeof(arena_chunk) + 15) & ~size_t(15);
+        if (cache.chunk == nullptr || cache.chunk->used + header_size + capacity > cache.chunk->size) {
+            retire_chunk(cache);
+            const size_t chunk_size = global().options.arena_chunk_bytes;
+            void* memory = std::malloc(chunk_size);
+            if (memory == nullptr) {
+                return nullptr;
+            }
+            cache.chunk = new (memory) arena_chunk();
+            cache.chunk->used = chunk_header;
+            cache.chunk->size = chunk_size;
+            thread_counters::add(cache.counters.arena_chunks, 1);
+        }
+
+        block_header* block = reinterpret_cast<block_header*>(reinterpret_cast<char*>(cache.chunk) + cache.chunk->used);
+        block->tag = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(cache.chunk));
+        block->capacity = capacity;
+        cache.chunk->used += header_size + capacity;
+        cache.chunk->live.fetch_add(1, std::memory_order_relaxed);
+        thread_counters::add(cache.counters.arena_allocations, 1);
+        return payload(block);
+    }
+
+    /// @brief sqlite3_mem_methods::xMalloc
+    static void* allocate(int requested)
+    {
+        const size_t bytes = static_cast<size_t>(std::max(requested, 1));
+        thread_cache* cache = current_cache();
+        void* memory = nullptr;
+        if (cache != nullptr) {
+            if (cache->arena_depth > 0 && bytes <= global().options.arena_max_allocation) {
+                memory = allocate_from_arena(*cache, bytes);
+            }
+            else {
+                const size_t index = class_of(bytes);
+                if (index < class_count && (cache->lists[index].count > 0 || refill(*cache, index))) {
+                    memory = payload(cache->lists[index].pop());
+                    thread_counters::add(cache->counters.pool_allocations, 1);
+                }
+            }
+        }
+        if (memory == nullptr) {
+            const size_t capacity = (bytes + 15) & ~size_t(15);
+            block_header* block = static_cast<block_header*>(std::malloc(header_size + capacity));
+            if (block == nullptr) {
+                return nullptr;
+            }
+            block->tag = fallback_tag;
+            block->capacity = capacity;
+            memory = payload(block);
+            if (cache != nullptr) {
+                thread_counters::add(cache->counters.fallback_allocations, 1);
+            }
+        }
+        if (cache != nullptr) {
+            thread_counters::add(cache->counters.allocations, 1);
+            thread_counters::add(cache->counters.bytes_in_use, header_of(memory)->capacity);
+        }
+        else {
+            // Thread is exiting, count into finished threads to keep bytes_in_use exact for uninstall()
+            global_state& state = global();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            ++state.finished_threads.allocations;
+            ++state.finished_threads.fallback_allocations;
+            state.finished_threads.bytes_in_use += static_cast<int64_t>(header_of(memory)->capacity);
+        }
+        return memory;
+    }
+
+    /// @brief sqlite3_mem_methods::xFree
+    static void release(void* memory)
+    {
+        if (memory == nullptr) {
+            return;
+        }
+        block_header* block = header_of(memory);
+        thread_cache* cache = current_cache();
+        if (cache != nullptr) {
+            thread_counters::add(cache->counters.frees, 1);
+            thread_counters::add(cache->counters.bytes_in_use, -static_cast<int64_t>(block->capacity));
+        }
+        else {
+            global_state& state = global();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            ++state.finished_threads.frees;
+            state.finished_threads.bytes_in_use -= static_cast<int64_t>(block->capacity);
+        }
+
+        if (block->tag == fallback_tag) {
+            std::free(block);
+        }
+        else if (block->tag >= class_count) {
+            arena_chunk* chunk = reinterpret_cast<arena_chunk*>(static_cast<uintptr_t>(block->tag));
+            if (chunk->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                chunk->~arena_chunk();
+                std::free(chunk);
+            }
+        }
+        else {
+            const size_t index = static_cast<size_t>(block->tag);
+            global_state& state = global();
+            if (cache == nullptr) {
+                free_list single;
+                single.push(block);
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.depot[index].push_back(single);
+                return;
+            }
+            free_list& list = cache->lists[index];
+            list.push(block);
+            const size_t limit = std::max<size_t>(16, state.options.thread_cache_bytes / (header_size + class_capacity(index)));
+            if (list.count > limit) {
+                // Keep half, the other half goes to threads which allocate more than free
+                free_list batch;
+                while (list.count > limit / 2) {
+                    batch.push(list.pop());
+                }
+                thread_counters::add(cache->counters.depot_returns, 1);
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.depot[index].push_back(batch);
+            }
+        }
+    }
+
+    /// @brief sqlite3_mem_methods::xRealloc
+    static void* reallocate(void* memory, int requested)
+    {
+        if (requested > 0 && static_cast<uint64_t>(requested) <= header_of(memory)->capacity) {
+            return memory;
+        }
+        void* resized = allocate(requested);
+        if (resized != nullptr) {
+            std::memcpy(resized, memory, static_cast<size_t>(header_of(memory)->capacity));
+            release(memory);
+        }
+        return resized;
+    }
+
+    /// @brief sqlite3_mem_methods::xSize
+    static int size(void* memory)
+    {
+        return (memory != nullptr) ? static_cast<int>(header_of(memory)->capacity) : 0;
+    }
+
+    /// @brief sqlite3_mem_methods::xRoundup, SQLite makes use of the whole block
+    static int roundup(int requested)
+    {
+        const size_t bytes = static_cast<size_t>(std::max(requested, 1));
+        const size_t index = class_of(bytes);
+        return static_cast<int>((index < class_count) ? class_capacity(index) : (bytes + 15) & ~size_t(15));
+    }
+
+    static int init(void*)
+    {
+        return SQLITE_OK;
+    }
+
+    static void shutdown(void*)
+    {
+    }
+
+public:
+
+    /// @brief Route small allocations of the current thread into the bump arena while alive
+    /// Scopes may nest; memory allocated inside may outlive the scope, it is then freed individually
+    class arena_scope
+    {
+    public:
+
+        arena_scope()
+        {
+            cache_ = current_cache();
+            if (cache_ != nullptr) {
+                ++cache_->arena_depth;
+            }
+        }
+
+        ~arena_scope()
+        {
+            if (cache_ != nullptr && --cache_->arena_depth == 0) {
+                retire_chunk(*cache_);
+            }
+        }
+
+        arena_scope(const arena_scope&) = delete;
+        arena_scope& operator=(const arena_scope&) = delete;
+
+    private:
+
+        thread_cache* cache_;
+    };
+};
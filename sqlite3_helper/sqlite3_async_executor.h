@@ -0,0 +1,537 @@
+#pragma once
+
+#include "sqlite3_helper.h"
+#include "sqlite3_coroutine.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+/// @brief Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's algorithm)
+/// Every cell carries a sequence number telling producers and consumers whose turn it is,
+/// so push and pop are a single CAS on the respective position in the common case
+template <typename T>
+class sqlite3_mpmc_queue
+{
+public:
+
+    /// @param capacity: rounded up to a power of two
+    explicit sqlite3_mpmc_queue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_.reset(new cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    sqlite3_mpmc_queue(const sqlite3_mpmc_queue&) = delete;
+    sqlite3_mpmc_queue& operator=(const sqlite3_mpmc_queue&) = delete;
+
+    /// @return: false if the queue is full
+    bool try_push(T value)
+    {
+        size_t position = enqueue_position_.load(std::memory_order_relaxed);
+        cell* target = nullptr;
+        for (;;) {
+            target = &cells_[position & mask_];
+            const size_t sequence = target->sequence.load(std::memory_order_acquire);
+            const std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+            if (difference == 0) {
+                if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                position = enqueue_position_.load(std::memory_order_relaxed);
+            }
+        }
+        target->value = std::move(value);
+        target->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @return: false if the queue is empty
+    bool try_pop(T& value)
+    {
+        size_t position = dequeue_position_.load(std::memory_order_relaxed);
+        cell* target = nullptr;
+        for (;;) {
+            target = &cells_[position & mask_];
+            const size_t sequence = target->sequence.load(std::memory_order_acquire);
+            const std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+            if (difference == 0) {
+                if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                position = dequeue_position_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(target->value);
+        target->sequence.store(position + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+
+    struct cell
+    {
+        std::atomic<size_t> sequence{ 0 };
+        T value{};
+    };
+
+    std::unique_ptr<cell[]> cells_;
+    size_t mask_ = 0;
+
+    /// Positions are kept on separate cache lines, producers and consumers do not share them
+    alignas(64) std::atomic<size_t> enqueue_position_{ 0 };
+    alignas(64) std::atomic<size_t> dequeue_position_{ 0 };
+};
+
+/// @brief Query arguments are copied into the task, text is kept as std::string
+/// so that the caller's buffers do not need to outlive the query
+template <typename T>
+struct sqlite3_async_argument
+{
+    using type = std::decay_t<T>;
+};
+
+template <>
+struct sqlite3_async_argument<const char*>
+{
+    using type = std::string;
+};
+
+template <>
+struct sqlite3_async_argument<char*>
+{
+    using type = std::string;
+};
+
+template <>
+struct sqlite3_async_argument<std::string_view>
+{
+    using type = std::string;
+};
+
+/// @brief Rows materialized by a worker thread
+template <typename Row>
+struct sqlite3_async_result
+{
+    /// SQLite error code of the query
+    int return_code = SQLITE_OK;
+
+    /// Rows in the order returned by SQLite
+    std::vector<Row> rows;
+};
+
+/// @brief Result of work which did not run because the executor has no connections
+/// Error code is reported for int and sqlite3_async_result, other results get a broken promise
+/// (future.get() throws std::future_error), as there is no value to complete them with
+template <typename Result>
+struct sqlite3_async_failure
+{
+    static constexpr bool reported = false;
+};
+
+template <>
+struct sqlite3_async_failure<int>
+{
+    static constexpr bool reported = true;
+
+    static int make(int return_code)
+    {
+        return return_code;
+    }
+};
+
+template <typename Row>
+struct sqlite3_async_failure<sqlite3_async_result<Row>>
+{
+    static constexpr bool reported = true;
+
+    static sqlite3_async_result<Row> make(int return_code)
+    {
+        sqlite3_async_result<Row> result;
+        result.return_code = return_code;
+        return result;
+    }
+};
+
+/// @brief Runs queries on a few dedicated connections, each owned by its own worker thread
+/// Queries are accepted from any thread through a lock-free queue and results are returned
+/// through std::future, fully materialized, so blocking I/O never happens on the caller's thread.
+/// With WAL several workers read concurrently, each from its own snapshot.
+/// Row types should own their data (std::string rather than std::string_view),
+/// as SQLite buffers are gone by the time the future is ready
+class sqlite3_async_executor
+{
+public:
+
+    /// @brief Open one connection per worker and start the workers
+    /// If any connection fails to open, no worker is started and queued work is completed
+    /// with the open error without running, see sqlite3_async_failure
+    /// @param worker_count: SQLITE_MISUSE if 0
+    /// @param options: SQLITE_OPEN_NOMUTEX is added to the flags, every connection is used by one thread
+    /// @param statement_cache_capacity: prepared statements cache of every connection
+    sqlite3_async_executor(const char* database_name, size_t worker_count = 2,
+        const sqlite3_helper::open_options& options = sqlite3_helper::open_options(),
+        size_t statement_cache_capacity = 64,
+        size_t queue_capacity = 1024) :
+        queue_(queue_capacity)
+    {
+        if (worker_count == 0) {
+            current_return_code_ = SQLITE_MISUSE;
+            return;
+        }
+        sqlite3_helper::open_options worker_options = options;
+        worker_options.flags |= SQLITE_OPEN_NOMUTEX;
+
+        connections_.reserve(worker_count);
+        for (size_t i = 0; i < worker_count; ++i) {
+            connections_.emplace_back(database_name, worker_options);
+            if ((current_return_code_ = connections_.back().get_last_error()) != SQLITE_OK) {
+                connections_.clear();
+                return;
+            }
+            connections_.back().set_statement_cache_capacity(statement_cache_capacity);
+        }
+        workers_.reserve(worker_count);
+        for (size_t i = 0; i < worker_count; ++i) {
+            workers_.emplace_back(&sqlite3_async_executor::run, this, std::ref(connections_[i]));
+        }
+    }
+
+    /// @brief Finish queued work and stop the workers
+    ~sqlite3_async_executor()
+    {
+        stop_.store(true);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        wakeup_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    sqlite3_async_executor(const sqlite3_async_executor&) = delete;
+    sqlite3_async_executor& operator=(const sqlite3_async_executor&) = delete;
+
+    /// @brief Run any work on a worker connection
+    /// @param work: callable taking sqlite3_helper&, not called if the executor has no connections
+    template <typename Work>
+    auto submit(Work&& work) -> std::future<std::invoke_result_t<std::decay_t<Work>&, sqlite3_helper&>>
+    {
+        using result_type = std::invoke_result_t<std::decay_t<Work>&, sqlite3_helper&>;
+        std::unique_ptr<task<result_type, std::decay_t<Work>>> job(new task<result_type, std::decay_t<Work>>(std::forward<Work>(work)));
+        std::future<result_type> future = job->result.get_future();
+        enqueue(std::move(job));
+        return future;
+    }
+
+    /// @brief Run any work on a worker connection without creating a future
+    /// @param work: callable taking sqlite3_helper&, its result is discarded; dropped if the executor has no connections
+    template <typename Work>
+    void post(Work&& work)
+    {
+        post(std::forward<Work>(work), [](int) {});
+    }
+
+    /// @brief Run any work on a worker connection without creating a future
+    /// @param on_failure: callable taking SQLite error code, called instead of work if the executor has no connections
+    template <typename Work, typename Failure>
+    void post(Work&& work, Failure&& on_failure)
+    {
+        enqueue(std::unique_ptr<task_base>(new posted_task<std::decay_t<Work>, std::decay_t<Failure>>(
+            std::forward<Work>(work), std::forward<Failure>(on_failure))));
+    }
+
+    /// @brief Execute SQL on a worker connection
+    std::future<int> exec(const char* sql)
+    {
+        return submit([sql = std::string(sql)](sqlite3_helper& db) {
+            return db.exec(sql.c_str());
+        });
+    }
+
+    /// @brief Run single-statement query on a worker connection and collect all rows
+    /// Row is a tuple, an aggregate or any type having sqlite3_row_traits specialization
+    template <typename Row, typename... Args>
+    std::future<sqlite3_async_result<Row>> query_as(const char* sql, const Args&... args)
+    {
+        using arguments_type = std::tuple<typename sqlite3_async_argument<std::decay_t<Args>>::type...>;
+        return submit([sql = std::string(sql), arguments = arguments_type(args...)](sqlite3_helper& db) {
+            sqlite3_async_result<Row> result;
+            result.return_code = std::apply([&](const auto&... values) {
+                return db.query_as(result.rows, sql.c_str(), values...);
+            }, arguments);
+            return result;
+        });
+    }
+
+#ifdef SQLITE3_HELPER_COROUTINES
+    /// @brief Coroutine version of query_as(), auto result = co_await executor.query_async<Row>(sql, args...);
+    /// Append .via(scheduler) to resume the coroutine on the caller's executor
+    /// instead of the worker thread
+    template <typename Row, typename... Args>
+    auto query_async(const char* sql, const Args&... args)
+    {
+        using arguments_type = std::tuple<typename sqlite3_async_argument<std::decay_t<Args>>::type...>;
+        auto query = [sql = std::string(sql), arguments = arguments_type(args...)](sqlite3_helper& db) {
+            sqlite3_async_result<Row> result;
+            result.return_code = std::apply([&](const auto&... values) {
+                return db.query_as(result.rows, sql.c_str(), values...);
+            }, arguments);
+            return result;
+        };
+        return sqlite3_query_awaitable<sqlite3_async_executor, sqlite3_async_result<Row>, decltype(query)>(*this, std::move(query));
+    }
+
+    /// @brief Stream rows of a single-statement query into a coroutine
+    /// while (const Row* row = co_await stream.next()) { ... }
+    /// The worker is kept busy until the query is finished or the stream is destroyed
+    /// @param chunk_rows: rows handed over at once
+    /// @param max_chunks: chunks the worker may run ahead of the consumer
+    template <typename Row, typename... Args>
+    sqlite3_row_stream<Row> query_stream(size_t chunk_rows, size_t max_chunks, const char* sql, const Args&... args)
+    {
+        using channel_type = typename sqlite3_row_stream<Row>::channel;
+        using arguments_type = std::tuple<typename sqlite3_async_argument<std::decay_t<Args>>::type...>;
+        std::shared_ptr<channel_type> channel = std::make_shared<channel_type>();
+        channel->max_chunks = (max_chunks > 0) ? max_chunks : 1;
+        chunk_rows = (chunk_rows > 0) ? chunk_rows : 1;
+
+        auto query = [channel, chunk_rows, sql = std::string(sql), arguments = arguments_type(args...)](sqlite3_helper& db) {
+            sqlite3_helper::query_result result = std::apply([&](const auto&... values) {
+                return db.query(sql.c_str(), values...);
+            }, arguments);
+            sqlite3_stmt* stmt = result.get_statement().handle();
+            if (db.get_last_error() != SQLITE_OK || stmt == nullptr) {
+                channel->finish(db.get_last_error());
+                return;
+            }
+            if (sqlite3_column_count(stmt) != sqlite3_row_traits<Row>::column_count) {
+                channel->finish(SQLITE_MISMATCH);
+                return;
+            }
+            std::vector<Row> chunk;
+            chunk.reserve(chunk_rows);
+            for (auto it = result.begin(); it != result.end(); ++it) {
+                chunk.push_back(sqlite3_row_traits<Row>::get(stmt));
+                if (chunk.size() == chunk_rows) {
+                    if (!channel->push(std::move(chunk))) {
+                        channel->finish(SQLITE_ABORT);
+                        return;
+                    }
+                    chunk = std::vector<Row>();
+                    chunk.reserve(chunk_rows);
+                }
+            }
+            if (!chunk.empty() && !channel->push(std::move(chunk))) {
+                channel->finish(SQLITE_ABORT);
+                return;
+            }
+            channel->finish(db.get_last_error());
+        };
+        post(std::move(query), [channel](int return_code) {
+            channel->finish(return_code);
+        });
+        return sqlite3_row_stream<Row>(std::move(channel));
+    }
+#endif
+
+    /// @brief Number of worker connections
+    size_t worker_count() const
+    {
+        return workers_.size();
+    }
+
+    /// @brief Are all connections opened successfully
+    operator bool() const
+    {
+        return is_valid();
+    }
+
+    /// @brief Are all connections opened successfully
+    bool is_valid() const
+    {
+        return current_return_code_ == SQLITE_OK;
+    }
+
+    /// @brief Return error code of opening connections
+    int get_last_error() const
+    {
+        return current_return_code_;
+    }
+
+    /// @brief Return last error message based on error code
+    const char* get_last_error_message() const
+    {
+        return sqlite3_errstr(current_return_code_);
+    }
+
+private:
+
+    /// @brief Type-erased queued work
+    struct task_base
+    {
+        virtual ~task_base() = default;
+        virtual void run(sqlite3_helper& db) = 0;
+
+        /// @brief Complete the work without running it, the executor has no connections
+        virtual void fail(int return_code) = 0;
+    };
+
+    /// @brief Work with a future, used by submit()
+    template <typename Result, typename Work>
+    struct task : task_base
+    {
+        template <typename Callable>
+        explicit task(Callable&& callable) :
+            work(std::forward<Callable>(callable))
+        {
+        }
+
+        void run(sqlite3_helper& db) override
+        {
+            // As std::packaged_task, exception of the work is passed into the future
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    work(db);
+                    result.set_value();
+                }
+                else {
+                    result.set_value(work(db));
+                }
+            }
+            catch (...) {
+                result.set_exception(std::current_exception());
+            }
+        }
+
+        void fail(int return_code) override
+        {
+            if constexpr (sqlite3_async_failure<Result>::reported) {
+                result.set_value(sqlite3_async_failure<Result>::make(return_code));
+            }
+            else {
+                // Promise is broken on destruction
+                static_cast<void>(return_code);
+            }
+        }
+
+        Work work;
+        std::promise<Result> result;
+    };
+
+    /// @brief Work without a future, used by post()
+    template <typename Work, typename Failure>
+    struct posted_task : task_base
+    {
+        template <typename Callable, typename FailureCallable>
+        posted_task(Callable&& callable, FailureCallable&& failure) :
+            work(std::forward<Callable>(callable)),
+            on_failure(std::forward<FailureCallable>(failure))
+        {
+        }
+
+        void run(sqlite3_helper& db) override
+        {
+            work(db);
+        }
+
+        void fail(int return_code) override
+        {
+            on_failure(return_code);
+        }
+
+        Work work;
+        Failure on_failure;
+    };
+
+    /// @brief Push into the queue, yielding while it is full, and wake an idle worker
+    void enqueue(std::unique_ptr<task_base> job)
+    {
+        if (workers_.empty()) {
+            // No connections: report the open error without running the work,
+            // which would call SQLite with a null handle
+            job->fail(current_return_code_);
+            return;
+        }
+        task_base* raw = job.release();
+        while (!queue_.try_push(raw)) {
+            std::this_thread::yield();
+        }
+        pending_.fetch_add(1);
+        if (idle_.load() > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_.notify_one();
+        }
+    }
+
+    /// @brief Worker loop, sleeps only when the queue is empty
+    void run(sqlite3_helper& db)
+    {
+        for (;;) {
+            task_base* raw = nullptr;
+            if (queue_.try_pop(raw)) {
+                pending_.fetch_sub(1);
+                std::unique_ptr<task_base> job(raw);
+                job->run(db);
+                continue;
+            }
+            if (stop_.load()) {
+                return;
+            }
+
+            idle_.fetch_add(1);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait(lock, [this] { return pending_.load() > 0 || stop_.load(); });
+            }
+            idle_.fetch_sub(1);
+        }
+    }
+
+    /// Queued work, owned by raw pointers while in the queue
+    sqlite3_mpmc_queue<task_base*> queue_;
+
+    /// Connection of every worker
+    std::vector<sqlite3_helper> connections_;
+
+    std::vector<std::thread> workers_;
+
+    /// Tasks pushed and not yet popped, and workers going to sleep;
+    /// sequentially consistent, so that a push never misses a sleeping worker
+    std::atomic<std::ptrdiff_t> pending_{ 0 };
+    std::atomic<size_t> idle_{ 0 };
+    std::atomic<bool> stop_{ false };
+
+    /// Used only to put idle workers to sleep
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+
+    /// Error code of opening connections
+    int current_return_code_ = SQLITE_OK;
+};
@@ -0,0 +1,392 @@
+#pragma once
+
+#include "sqlite3_helper.h"
+#include <algorithm>
+#include <climits>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+/// @brief RAII wrapper under sqlite3_blob: incremental I/O of one BLOB without loading it whole
+/// BLOB size is fixed, to write a new one insert sqlite3_zeroblob of the required size first.
+/// The handle expires (reads and writes return SQLITE_ABORT) when the row is modified otherwise than through it.
+/// The helper should outlive the stream. As sqlite3_helper, it does not throw exceptions
+class sqlite3_blob_stream
+{
+public:
+
+    /// @brief Empty-state stream
+    sqlite3_blob_stream()
+    {}
+
+    /// @brief Open BLOB in the row of the table
+    /// @param writable: open for writing as well as for reading
+    /// @param schema: "main", "temp" or attached database name
+    sqlite3_blob_stream(const sqlite3_helper& db, const char* table, const char* column, sqlite3_int64 rowid,
+        bool writable = false, const char* schema = "main")
+    {
+        current_return_code_ = sqlite3_blob_open(db.handle(), schema, table, column, rowid, writable ? 1 : 0, &blob_);
+    }
+
+    /// @brief Close BLOB handle
+    ~sqlite3_blob_stream()
+    {
+        close();
+    }
+
+    /// No copy
+    sqlite3_blob_stream(const sqlite3_blob_stream&) = delete;
+
+    /// No assignment
+    sqlite3_blob_stream& operator=(const sqlite3_blob_stream&) = delete;
+
+    /// @brief Move c-tor leaves rhs-object in empty state
+    sqlite3_blob_stream(sqlite3_blob_stream&& rhs) :
+        blob_(rhs.blob_),
+        position_(rhs.position_),
+        current_return_code_(rhs.current_return_code_)
+    {
+        rhs.blob_ = nullptr;
+        rhs.position_ = 0;
+    }
+
+    /// @brief Move assignment closes own handle and leaves rhs-object in empty state
+    sqlite3_blob_stream& operator=(sqlite3_blob_stream&& rhs)
+    {
+        if (this != &rhs) {
+            close();
+            blob_ = rhs.blob_;
+            position_ = rhs.position_;
+            current_return_code_ = rhs.current_return_code_;
+            rhs.blob_ = nullptr;
+            rhs.position_ = 0;
+        }
+        return *this;
+    }
+
+    /// @brief Close BLOB handle, a writable handle commits pending changes in autocommit mode
+    /// @return: SQLite error code
+    int close()
+    {
+        if (blob_ != nullptr) {
+            current_return_code_ = sqlite3_blob_close(blob_);
+            blob_ = nullptr;
+        }
+        return current_return_code_;
+    }
+
+    /// @brief Move to BLOB of another row of the same table and column, faster than opening a new handle
+    /// @return: SQLite error code
+    int reopen(sqlite3_int64 rowid)
+    {
+        current_return_code_ = sqlite3_blob_reopen(blob_, rowid);
+        position_ = 0;
+        return current_return_code_;
+    }
+
+    /// @brief BLOB size in bytes
+    int size() const
+    {
+        return (blob_ != nullptr) ? sqlite3_blob_bytes(blob_) : 0;
+    }
+
+    /// @brief Read bytes at the offset, the range must be within the BLOB
+    /// @return: SQLite error code, SQLITE_ERROR if out of range
+    int read(void* buffer, int bytes, int offset)
+    {
+        current_return_code_ = sqlite3_blob_read(blob_, buffer, bytes, offset);
+        return current_return_code_;
+    }
+
+    /// @brief Write bytes at the offset, the range must be within the BLOB
+    /// @return: SQLite error code, SQLITE_ERROR if out of range, SQLITE_READONLY if not writable
+    int write(const void* data, int bytes, int offset)
+    {
+        current_return_code_ = sqlite3_blob_write(blob_, data, bytes, offset);
+        return current_return_code_;
+    }
+
+    /// @brief Read the next chunk from the current position into caller buffer
+    /// @param bytes_read: bytes read, less than capacity only at the end of BLOB
+    /// @return: SQLite error code
+    int read_chunk(void* buffer, int capacity, int& bytes_read)
+    {
+        bytes_read = std::max(0, std::min(capacity, size() - position_));
+        if (bytes_read > 0 && read(buffer, bytes_read, position_) == SQLITE_OK) {
+            position_ += bytes_read;
+        }
+        else if (bytes_read > 0) {
+            bytes_read = 0;
+        }
+        return current_return_code_;
+    }
+
+    /// @brief Write chunk at the current position
+    /// @return: SQLite error code, SQLITE_ERROR if it does not fit into the BLOB
+    int write_chunk(const void* data, int bytes)
+    {
+        if (write(data, bytes, position_) == SQLITE_OK) {
+            position_ += bytes;
+        }
+        return current_return_code_;
+    }
+
+    /// @brief Current position of read_chunk() and write_chunk()
+    int tell() const
+    {
+        return position_;
+    }
+
+    /// @brief Move the current position, limited to BLOB bounds
+    void seek(int position)
+    {
+        position_ = std::max(0, std::min(position, size()));
+    }
+
+    /// @brief Underlying BLOB handle, owned by the object
+    sqlite3_blob* handle() const
+    {
+        return blob_;
+    }
+
+    /// @brief Is BLOB opened and last operation succeeded
+    operator bool() const
+    {
+        return is_valid();
+    }
+
+    /// @brief Is BLOB opened and last operation succeeded
+    bool is_valid() const
+    {
+        return blob_ != nullptr && current_return_code_ == SQLITE_OK;
+    }
+
+    /// @brief Return last error code of any BLOB operation
+    int get_last_error() const
+    {
+        return current_return_code_;
+    }
+
+    /// @brief Return last error message based on error code
+    const char* get_last_error_message() const
+    {
+        return sqlite3_errstr(current_return_code_);
+    }
+
+private:
+
+    /// BLOB handle, nullptr in empty state
+    sqlite3_blob* blob_ = nullptr;
+
+    /// Offset of the next read_chunk() or write_chunk()
+    int position_ = 0;
+
+    /// Last operation result
+    int current_return_code_ = SQLITE_OK;
+};
+
+/// @brief std::streambuf over sqlite3_blob_stream, buffered in chunks
+/// Large reads and writes bypass the buffer and go directly between the caller and the BLOB.
+/// Writing past the end of BLOB fails, as its size is fixed
+class sqlite3_blob_streambuf : public std::streambuf
+{
+public:
+
+    /// @param blob: not owned, should outlive the buffer
+    /// @param chunk_size: bytes transferred by one BLOB read or write, at most INT_MAX
+    explicit sqlite3_blob_streambuf(sqlite3_blob_stream& blob, size_t chunk_size = 64 * 1024) :
+        blob_(blob),
+        buffer_(std::min<size_t>(std::max<size_t>(chunk_size, 1), INT_MAX))
+    {
+    }
+
+    ~sqlite3_blob_streambuf() override
+    {
+        flush();
+    }
+
+protected:
+
+    int_type underflow() override
+    {
+        if (flush() != 0) {
+            return traits_type::eof();
+        }
+        setp(nullptr, nullptr);
+        int bytes_read = 0;
+        if (blob_.read_chunk(buffer_.data(), static_cast<int>(buffer_.size()), bytes_read) != SQLITE_OK || bytes_read == 0) {
+            return traits_type::eof();
+        }
+        setg(buffer_.data(), buffer_.data(), buffer_.data() + bytes_read);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::streamsize xsgetn(char* data, std::streamsize count) override
+    {
+        std::streamsize copied = std::min<std::streamsize>(count, egptr() - gptr());
+        std::copy(gptr(), gptr() + copied, data);
+        gbump(static_cast<int>(copied));
+        if (copied < count && count - copied >= static_cast<std::streamsize>(buffer_.size())) {
+            // Read the rest directly into caller buffer
+            if (flush() != 0) {
+                return copied;
+            }
+            setp(nullptr, nullptr);
+            // BLOB I/O takes int sizes
+            int bytes_read = 0;
+            while (copied < count
+                && blob_.read_chunk(data + copied, static_cast<int>(std::min<std::streamsize>(count - copied, INT_MAX)), bytes_read) == SQLITE_OK
+                && bytes_read > 0) {
+                copied += bytes_read;
+            }
+            return copied;
+        }
+        while (copied < count && underflow() != traits_type::eof()) {
+            const std::streamsize chunk = std::min<std::streamsize>(count - copied, egptr() - gptr());
+            std::copy(gptr(), gptr() + chunk, data + copied);
+            gbump(static_cast<int>(chunk));
+            copied += chunk;
+        }
+        return copied;
+    }
+
+    int_type overflow(int_type c) override
+    {
+        discard_input();
+        if (pbase() == nullptr) {
+            setp(buffer_.data(), buffer_.data() + buffer_.size());
+        }
+        else if (flush() != 0) {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize count) override
+    {
+        if (count < static_cast<std::streamsize>(buffer_.size())) {
+            return std::streambuf::xsputn(data, count);
+        }
+        // Write large chunks directly from caller buffer, BLOB I/O takes int sizes
+        discard_input();
+        if (flush() != 0) {
+            return 0;
+        }
+        std::streamsize written = 0;
+        while (written < count) {
+            const int chunk = static_cast<int>(std::min<std::streamsize>(count - written, INT_MAX));
+            if (blob_.write_chunk(data + written, chunk) != SQLITE_OK) {
+                break;
+            }
+            written += chunk;
+        }
+        return written;
+    }
+
+    int sync() override
+    {
+        return flush();
+    }
+
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode) override
+    {
+        if (flush() != 0) {
+            return pos_type(off_type(-1));
+        }
+        // Position of the next byte, the BLOB is ahead by the unread part of the buffer
+        const off_type current = blob_.tell() - (egptr() - gptr());
+        off_type target = offset;
+        if (direction == std::ios_base::cur) {
+            target += current;
+        }
+        else if (direction == std::ios_base::end) {
+            target += blob_.size();
+        }
+        if (target < 0 || target > blob_.size()) {
+            return pos_type(off_type(-1));
+        }
+        discard_input();
+        blob_.seek(static_cast<int>(target));
+        return pos_type(target);
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode mode) override
+    {
+        return seekoff(off_type(position), std::ios_base::beg, mode);
+    }
+
+private:
+
+    /// @brief Write buffered output into the BLOB
+    /// @return: 0 on success, -1 on error
+    int flush()
+    {
+        if (pbase() == nullptr) {
+            return 0;
+        }
+        const std::ptrdiff_t pending = pptr() - pbase();
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+        return (pending > 0 && blob_.write_chunk(buffer_.data(), static_cast<int>(pending)) != SQLITE_OK) ? -1 : 0;
+    }
+
+    /// @brief Drop buffered input before writing or seeking, moving BLOB position back to the next unread byte
+    void discard_input()
+    {
+        if (gptr() != egptr()) {
+            blob_.seek(blob_.tell() - static_cast<int>(egptr() - gptr()));
+        }
+        setg(buffer_.data(), buffer_.data(), buffer_.data());
+    }
+
+    sqlite3_blob_stream& blob_;
+
+    /// Shared by input and output, only one of them is active at a time
+    std::vector<char> buffer_;
+};
+
+/// @brief std::istream reading a BLOB in chunks
+class sqlite3_blob_istream : public std::istream
+{
+public:
+
+    /// @param blob: not owned, should outlive the stream
+    explicit sqlite3_blob_istream(sqlite3_blob_stream& blob, size_t chunk_size = 64 * 1024) :
+        std::istream(nullptr),
+        buffer_(blob, chunk_size)
+    {
+        rdbuf(&buffer_);
+    }
+
+private:
+
+    sqlite3_blob_streambuf buffer_;
+};
+
+/// @brief std::ostream writing a BLOB in chunks; fails past the end of BLOB, preallocate it with sqlite3_zeroblob
+class sqlite3_blob_ostream : public std::ostream
+{
+public:
+
+    /// @param blob: not owned, should be opened writable and outlive the stream
+    explicit sqlite3_blob_ostream(sqlite3_blob_stream& blob, size_t chunk_size = 64 * 1024) :
+        std::ostream(nullptr),
+        buffer_(blob, chunk_size)
+    {
+        rdbuf(&buffer_);
+    }
+
+    /// @brief Flush buffered output, so that it reaches the BLOB before it is closed
+    ~sqlite3_blob_ostream() override
+    {
+        flush();
+    }
+
+private:
+
+    sqlite3_blob_streambuf buffer_;
+};
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "sqlite3_helper.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/// @brief Container bound as an argument of carray() table-valued function
+/// SELECT * FROM files WHERE id IN carray(?)
+/// The container is referenced, not copied (sqlite3_bind_pointer), so it must stay alive and unchanged
+/// until the parameter is rebound, cleared or the statement is finalized.
+/// Supported element types: int64_t, sqlite3_int64, double, std::string_view and std::string
+template <typename T>
+struct sqlite3_carray_ref
+{
+    explicit sqlite3_carray_ref(const std::vector<T>& container) :
+        values(&container)
+    {
+    }
+
+    const std::vector<T>* values;
+};
+
+/// @brief Pointer type tags checked by sqlite3_value_pointer(), one per supported element type
+template <typename T, typename Enable = void>
+struct sqlite3_carray_pointer_type;
+
+template <>
+struct sqlite3_carray_pointer_type<int64_t>
+{
+    static constexpr const char* name = "sqlite3_carray_int64";
+};
+
+/// @brief sqlite3_int64 is long long, a type distinct from int64_t (long) on LP64 platforms
+template <typename T>
+struct sqlite3_carray_pointer_type<T, typename std::enable_if<std::is_same<T, sqlite3_int64>::value && !std::is_same<T, int64_t>::value>::type>
+{
+    static constexpr const char* name = "sqlite3_carray_sqlite3_int64";
+};
+
+template <>
+struct sqlite3_carray_pointer_type<double>
+{
+    static constexpr const char* name = "sqlite3_carray_double";
+};
+
+template <>
+struct sqlite3_carray_pointer_type<std::string_view>
+{
+    static constexpr const char* name = "sqlite3_carray_string_view";
+};
+
+template <>
+struct sqlite3_carray_pointer_type<std::string>
+{
+    static constexpr const char* name = "sqlite3_carray_string";
+};
+
+/// @brief Container bound by pointer, see sqlite3_carray_ref
+template <typename T>
+struct sqlite3_type_traits<sqlite3_carray_ref<T>>
+{
+    static int bind(sqlite3_stmt* stmt, int index, const sqlite3_carray_ref<T>& value)
+    {
+        return sqlite3_bind_pointer(stmt, index, const_cast<std::vector<T>*>(value.values), sqlite3_carray_pointer_type<T>::name, nullptr);
+    }
+};
+
+/// @brief carray() table-valued function: rows of a C++ container bound through sqlite3_carray_ref
+/// It is an eponymous-only virtual table with one column, "value", and a hidden argument column,
+/// so one prepared statement serves batches of any size instead of IN-lists of literals
+class sqlite3_carray
+{
+public:
+
+    /// @brief Register the function on the connection
+    /// @param name: function name used in SQL
+    /// @return: SQLite error code
+    static int create_module(const sqlite3_helper& db, const char* name = "carray")
+    {
+        return sqlite3_create_module(db.handle(), name, &module(), nullptr);
+    }
+
+    /// @brief Register the function as "carray" on every connection opened afterwards, process-wide
+    /// @return: SQLite error code
+    static int enable_for_all_connections()
+    {
+        return sqlite3_auto_extension(reinterpret_cast<void (*)(void)>(&sqlite3_carray::auto_extension));
+    }
+
+private:
+
+    /// @brief Element type of the bound container
+    enum class element_kind
+    {
+        none,
+        int64,
+        sqlite_int64,
+        real,
+        text_view,
+        text
+    };
+
+    struct cursor
+    {
+        sqlite3_vtab_cursor base;
+        element_kind kind;
+        const void* values;
+        size_t size;
+        size_t row;
+    };
+
+    /// Columns of the virtual table
+    static constexpr int value_column = 0;
+    static constexpr int array_column = 1;
+
+    static int auto_extension(sqlite3* db, char**, const sqlite3_api_routines*)
+    {
+        return sqlite3_create_module(db, "carray", &module(), nullptr);
+    }
+
+    static const sqlite3_module& module()
+    {
+        static const sqlite3_module methods = [] {
+            sqlite3_module result = {};
+            // xCreate is not set: eponymous-only, used without CREATE VIRTUAL TABLE
+            result.xConnect = &sqlite3_carray::connect;
+            result.xBestIndex = &sqlite3_carray::best_index;
+            result.xDisconnect = &sqlite3_carray::disconnect;
+            result.xOpen = &sqlite3_carray::open;
+            result.xClose = &sqlite3_carray::close;
+            result.xFilter = &sqlite3_carray::filter;
+            result.xNext = &sqlite3_carray::next;
+            result.xEof = &sqlite3_carray::eof;
+            result.xColumn = &sqlite3_carray::column;
+            result.xRowid = &sqlite3_carray::rowid;
+            return result;
+        }();
+        return methods;
+    }
+
+    static int connect(sqlite3* db, void*, int, const char* const*, sqlite3_vtab** table, char**)
+    {
+        const int return_code = sqlite3_declare_vtab(db, "CREATE TABLE x(value, array HIDDEN)");
+        if (return_code != SQLITE_OK) {
+            return return_code;
+        }
+        *table = static_cast<sqlite3_vtab*>(sqlite3_malloc(sizeof(sqlite3_vtab)));
+        if (*table == nullptr) {
+            return SQLITE_NOMEM;
+        }
+        **table = sqlite3_vtab();
+        return SQLITE_OK;
+    }
+
+    static int disconnect(sqlite3_vtab* table)
+    {
+        sqlite3_free(table);
+        return SQLITE_OK;
+    }
+
+    /// @brief Use the container argument; a plan without it is rejected, so carray without an argument
+    /// fails to prepare instead of silently giving no rows
+    static int best_index(sqlite3_vtab*, sqlite3_index_info* info)
+    {
+        for (int i = 0; i < info->nConstraint; ++i) {
+            const auto& constraint = info->aConstraint[i];
+            if (constraint.usable && constraint.iColumn == array_column && constraint.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+                info->aConstraintUsage[i].argvIndex = 1;
+                info->aConstraintUsage[i].omit = 1;
+                info->idxNum = 1;
+                info->estimatedCost = 1.0;
+                info->estimatedRows = 100;
+                return SQLITE_OK;
+            }
+        }
+        return SQLITE_CONSTRAINT;
+    }
+
+    static int open(sqlite3_vtab*, sqlite3_vtab_cursor** result)
+    {
+        cursor* current = static_cast<cursor*>(sqlite3_malloc(sizeof(cursor)));
+        if (current == nullptr) {
+            return SQLITE_NOMEM;
+        }
+        *current = cursor{ sqlite3_vtab_cursor(), element_kind::none, nullptr, 0, 0 };
+        *result = &current->base;
+        return SQLITE_OK;
+    }
+
+    static int close(sqlite3_vtab_cursor* base)
+    {
+        sqlite3_free(base);
+        return SQLITE_OK;
+    }
+
+    template <typename T>
+    static bool bind_values(cursor& current, sqlite3_value* argument, element_kind kind)
+    {
+        const std::vector<T>* values = static_cast<const std::vector<T>*>(sqlite3_value_pointer(argument, sqlite3_carray_pointer_type<T>::name));
+        if (values == nullptr) {
+            return false;
+        }
+        current.kind = kind;
+        current.values = values->data();
+        current.size = values->size();
+        return true;
+    }
+
+    /// @brief Start a scan of the container bound to the argument, NULL or a foreign value gives no rows
+    static int filter(sqlite3_vtab_cursor* base, int index_number, const char*, int argc, sqlite3_value** argv)
+    {
+        cursor& current = *reinterpret_cast<cursor*>(base);
+        current.kind = element_kind::none;
+        current.size = 0;
+        current.row = 0;
+        if (index_number == 1 && argc == 1) {
+            bind_values<int64_t>(current, argv[0], element_kind::int64)
+                || (!std::is_same<sqlite3_int64, int64_t>::value && bind_values<sqlite3_int64>(current, argv[0], element_kind::sqlite_int64))
+                || bind_values<double>(current, argv[0], element_kind::real)
+                || bind_values<std::string_view>(current, argv[0], element_kind::text_view)
+                || bind_values<std::string>(current, argv[0], element_kind::text);
+        }
+        return SQLITE_OK;
+    }
+
+    static int next(sqlite3_vtab_cursor* base)
+    {
+        ++reinterpret_cast<cursor*>(base)->row;
+        return SQLITE_OK;
+    }
+
+    static int eof(sqlite3_vtab_cursor* base)
+    {
+        const cursor& current = *reinterpret_cast<cursor*>(base);
+        return current.row >= current.size ? 1 : 0;
+    }
+
+    /// @brief Text is returned without copy, the container outlives the statement use
+    static int column(sqlite3_vtab_cursor* base, sqlite3_context* context, int index)
+    {
+        const cursor& current = *reinterpret_cast<cursor*>(base);
+        if (index != value_column) {
+            sqlite3_result_null(context);
+            return SQLITE_OK;
+        }
+        switch (current.kind) {
+        case element_kind::int64:
+            sqlite3_result_int64(context, static_cast<const int64_t*>(current.values)[current.row]);
+            break;
+        case element_kind::sqlite_int64:
+            sqlite3_result_int64(context, static_cast<const sqlite3_int64*>(current.values)[current.row]);
+            break;
+        case element_kind::real:
+            sqlite3_result_double(context, static_cast<const double*>(current.values)[current.row]);
+            break;
+        case element_kind::text_view: {
+            const std::string_view& text = static_cast<const std::string_view*>(current.values)[current.row];
+            sqlite3_result_text64(context, text.data() ? text.data() : "", static_cast<sqlite3_uint64>(text.size()), SQLITE_STATIC, SQLITE_UTF8);
+            break;
+        }
+        case element_kind::text: {
+            const std::string& text = static_cast<const std::string*>(current.values)[current.row];
+            sqlite3_result_text64(context, text.data(), static_cast<sqlite3_uint64>(text.size()), SQLITE_STATIC, SQLITE_UTF8);
+            break;
+        }
+        default:
+            sqlite3_result_null(context);
+            break;
+        }
+        return SQLITE_OK;
+    }
+
+    static int rowid(sqlite3_vtab_cursor* base, sqlite3_int64* result)
+    {
+        *result = static_cast<sqlite3_int64>(reinterpret_cast<cursor*>(base)->row) + 1;
+        return SQLITE_OK;
+    }
+};
@@ -0,0 +1,261 @@
+#pragma once
+
+// C++20 coroutine support for sqlite3_async_executor, empty for older language standards
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "sqlite3_helper.h"
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#define SQLITE3_HELPER_COROUTINES 1
+
+/// @brief Resumes a suspended coroutine, e.g. by posting the handle into the caller's event loop
+/// Empty scheduler resumes the coroutine directly on the database worker thread
+using sqlite3_resume_scheduler = std::function<void(std::coroutine_handle<>)>;
+
+/// @brief co_await-able query result
+/// Coroutine is suspended while a worker thread runs the query and materializes the rows,
+/// then it is resumed through the scheduler given to via(), or directly on the worker thread.
+/// Result has return_code member, e.g. sqlite3_async_result
+template <typename Executor, typename Result, typename Query>
+class sqlite3_query_awaitable
+{
+public:
+
+    sqlite3_query_awaitable(Executor& executor, Query&& query) :
+        executor_(executor),
+        query_(std::move(query))
+    {
+    }
+
+    /// @brief Resume the awaiting coroutine through the scheduler instead of the worker thread
+    sqlite3_query_awaitable&& via(sqlite3_resume_scheduler scheduler) &&
+    {
+        scheduler_ = std::move(scheduler);
+        return std::move(*this);
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> awaiting)
+    {
+        // The awaitable lives in the suspended coroutine frame until it is resumed
+        executor_.post([this, awaiting](sqlite3_helper& db) {
+            result_ = query_(db);
+            resume(awaiting);
+        }, [this, awaiting](int return_code) {
+            // Executor has no connections, the query is not run
+            result_.return_code = return_code;
+            resume(awaiting);
+        });
+    }
+
+    Result await_resume()
+    {
+        return std::move(result_);
+    }
+
+private:
+
+    void resume(std::coroutine_handle<> awaiting)
+    {
+        if (scheduler_) {
+            scheduler_(awaiting);
+        }
+        else {
+            awaiting.resume();
+        }
+    }
+
+    Executor& executor_;
+    Query query_;
+    sqlite3_resume_scheduler scheduler_;
+    Result result_;
+};
+
+/// @brief Async generator of query rows
+/// Worker thread steps the statement and hands rows over in chunks; when the consumer
+/// falls behind by max_chunks, the worker waits, so memory stays bounded
+/// while (const Row* row = co_await stream.next()) { ... }
+/// Row pointer is valid until the next call of next()
+template <typename Row>
+class sqlite3_row_stream
+{
+public:
+
+    /// @brief Rows exchange between the worker and the consumer coroutine
+    struct channel
+    {
+        std::mutex mutex;
+        std::condition_variable space_available;
+        std::deque<std::vector<Row>> chunks;
+        size_t max_chunks = 4;
+        bool done = false;
+        bool cancelled = false;
+        int return_code = SQLITE_OK;
+        std::coroutine_handle<> waiting;
+        sqlite3_resume_scheduler scheduler;
+
+        /// @brief Called by the worker, blocks while the consumer is max_chunks behind
+        /// @return: false if the consumer is gone
+        bool push(std::vector<Row>&& chunk)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            space_available.wait(lock, [this] { return chunks.size() < max_chunks || cancelled; });
+            if (cancelled) {
+                return false;
+            }
+            chunks.push_back(std::move(chunk));
+            wake(lock);
+            return true;
+        }
+
+        /// @brief Called by the worker when the statement is finished
+        void finish(int code)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done = true;
+            return_code = code;
+            wake(lock);
+        }
+
+    private:
+
+        /// @brief Resume the consumer suspended in next(), unless the stream is already destroyed
+        void wake(std::unique_lock<std::mutex>& lock)
+        {
+            std::coroutine_handle<> awaiting = std::exchange(waiting, nullptr);
+            const bool consumer_alive = !cancelled;
+            lock.unlock();
+            if (!awaiting || !consumer_alive) {
+                return;
+            }
+            if (scheduler) {
+                scheduler(awaiting);
+            }
+            else {
+                awaiting.resume();
+            }
+        }
+    };
+
+    /// @brief Awaitable of the next row
+    class next_awaitable
+    {
+    public:
+
+        explicit next_awaitable(sqlite3_row_stream& stream) :
+            stream_(stream)
+        {
+        }
+
+        bool await_ready()
+        {
+            return stream_.has_row() || stream_.take_chunk();
+        }
+
+        /// @return: false if a chunk arrived meanwhile, so the coroutine is not suspended
+        bool await_suspend(std::coroutine_handle<> awaiting)
+        {
+            channel& shared = *stream_.channel_;
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            if (!shared.chunks.empty() || shared.done) {
+                return false;
+            }
+            shared.waiting = awaiting;
+            return true;
+        }
+
+        /// @return: next row, nullptr when the query is finished
+        const Row* await_resume()
+        {
+            if (!stream_.has_row() && !stream_.take_chunk()) {
+                return nullptr;
+            }
+            return &stream_.current_[stream_.position_++];
+        }
+
+    private:
+
+        sqlite3_row_stream& stream_;
+    };
+
+    explicit sqlite3_row_stream(std::shared_ptr<channel> shared) :
+        channel_(std::move(shared))
+    {
+    }
+
+    /// @brief Stop the worker if the stream is abandoned before the end
+    /// Consumer coroutine may be destroyed while suspended in next(), the worker does not resume it then
+    ~sqlite3_row_stream()
+    {
+        if (channel_) {
+            std::lock_guard<std::mutex> lock(channel_->mutex);
+            channel_->cancelled = true;
+            channel_->waiting = nullptr;
+            channel_->space_available.notify_all();
+        }
+    }
+
+    sqlite3_row_stream(sqlite3_row_stream&&) = default;
+    sqlite3_row_stream& operator=(sqlite3_row_stream&&) = delete;
+
+    /// @brief Resume the consumer coroutine through the scheduler instead of the worker thread
+    /// Should be set before the first next()
+    sqlite3_row_stream& via(sqlite3_resume_scheduler scheduler)
+    {
+        std::lock_guard<std::mutex> lock(channel_->mutex);
+        channel_->scheduler = std::move(scheduler);
+        return *this;
+    }
+
+    next_awaitable next()
+    {
+        return next_awaitable(*this);
+    }
+
+    /// @brief SQLite error code of the query, valid when next() returned nullptr
+    int get_last_error() const
+    {
+        std::lock_guard<std::mutex> lock(channel_->mutex);
+        return channel_->return_code;
+    }
+
+private:
+
+    bool has_row() const
+    {
+        return position_ < current_.size();
+    }
+
+    /// @return: true if a new chunk is taken
+    bool take_chunk()
+    {
+        std::lock_guard<std::mutex> lock(channel_->mutex);
+        if (channel_->chunks.empty()) {
+            return false;
+        }
+        current_ = std::move(channel_->chunks.front());
+        channel_->chunks.pop_front();
+        position_ = 0;
+        channel_->space_available.notify_one();
+        return true;
+    }
+
+    std::shared_ptr<channel> channel_;
+
+    /// Chunk being consumed
+    std::vector<Row> current_;
+    size_t position_ = 0;
+};
+
+#endif
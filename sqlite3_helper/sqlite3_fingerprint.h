@@ -0,0 +1,273 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// @brief SQL fingerprint: statement text with literals and parameters replaced by '?'
+/// SELECT * FROM files WHERE id IN (1, 2, 3) AND name = 'a.txt'  ->  select*from files where id in(?...)and name=?
+/// Tokens are recognized by the rules of SQLite tokenizer (tokenize.c): comments and whitespace are dropped,
+/// unquoted words are lowercased as SQLite keywords and identifiers are case-insensitive,
+/// quoted identifiers are kept as is, IN-lists of literals collapse to (?...) whatever their length,
+/// and whitespace is kept only between two words
+class sqlite3_sql_fingerprint
+{
+public:
+
+    /// @brief Kinds of tokens, literals and parameters become '?'
+    enum class token_kind
+    {
+        word,
+        quoted_identifier,
+        literal,
+        punctuation
+    };
+
+    struct token
+    {
+        token_kind kind;
+        const char* begin;
+        size_t size;
+    };
+
+    /// @brief Fingerprint of the first statement in sql
+    static std::string make(const char* sql)
+    {
+        std::string result;
+        std::vector<token> tokens;
+        make(sql, result, tokens);
+        return result;
+    }
+
+    /// @brief Fingerprint into a caller-provided buffer, allocation-free once buffers have grown
+    /// @param tokens: scratch buffer
+    static void make(const char* sql, std::string& result, std::vector<token>& tokens)
+    {
+        result.clear();
+        tokenize(sql, tokens);
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            const token& current = tokens[i];
+            if (current.kind == token_kind::punctuation && current.size == 1 && current.begin[0] == '('
+                && i > 0 && is_in_keyword(tokens[i - 1])) {
+                const size_t list_end = literal_list_end(tokens, i + 1);
+                if (list_end != 0) {
+                    result += "(?...)";
+                    i = list_end;
+                    continue;
+                }
+            }
+            append(result, current);
+        }
+    }
+
+    /// @brief Split the first statement into tokens, dropping whitespace and comments
+    static void tokenize(const char* sql, std::vector<token>& tokens)
+    {
+        tokens.clear();
+        const char* c = sql;
+        while (*c != '\0') {
+            const char* begin = c;
+            if (is_space(*c)) {
+                ++c;
+            }
+            else if (c[0] == '-' && c[1] == '-') {
+                while (*c != '\0' && *c != '\n') {
+                    ++c;
+                }
+            }
+            else if (c[0] == '/' && c[1] == '*') {
+                c += 2;
+                while (*c != '\0' && !(c[0] == '*' && c[1] == '/')) {
+                    ++c;
+                }
+                c += (*c != '\0') ? 2 : 0;
+            }
+            else if (*c == ';') {
+                break;
+            }
+            else if (*c == '\'') {
+                c = skip_quoted(c, '\'');
+                tokens.push_back(token{ token_kind::literal, begin, static_cast<size_t>(c - begin) });
+            }
+            else if (*c == '"' || *c == '`') {
+                c = skip_quoted(c, *c);
+                tokens.push_back(token{ token_kind::quoted_identifier, begin, static_cast<size_t>(c - begin) });
+            }
+            else if (*c == '[') {
+                while (*c != '\0' && *c != ']') {
+                    ++c;
+                }
+                c += (*c != '\0') ? 1 : 0;
+                tokens.push_back(token{ token_kind::quoted_identifier, begin, static_cast<size_t>(c - begin) });
+            }
+            else if ((c[0] == 'x' || c[0] == 'X') && c[1] == '\'') {
+                c = skip_quoted(c + 1, '\'');
+                tokens.push_back(token{ token_kind::literal, begin, static_cast<size_t>(c - begin) });
+            }
+            else if (is_digit(*c) || (*c == '.' && is_digit(c[1]))) {
+                c = skip_number(c);
+                tokens.push_back(token{ token_kind::literal, begin, static_cast<size_t>(c - begin) });
+            }
+            else if (*c == '?') {
+                ++c;
+                while (is_digit(*c)) {
+                    ++c;
+                }
+                tokens.push_back(token{ token_kind::literal, begin, static_cast<size_t>(c - begin) });
+            }
+            else if ((*c == ':' || *c == '@' || *c == '$') && is_word_char(c[1])) {
+                ++c;
+                while (is_word_char(*c) || (c[0] == ':' && c[1] == ':')) {
+                    c += (*c == ':') ? 2 : 1;
+                }
+                tokens.push_back(token{ token_kind::literal, begin, static_cast<size_t>(c - begin) });
+            }
+            else if (is_word_char(*c)) {
+                while (is_word_char(*c)) {
+                    ++c;
+                }
+                tokens.push_back(token{ token_kind::word, begin, static_cast<size_t>(c - begin) });
+            }
+            else {
+                c += operator_size(c);
+                tokens.push_back(token{ token_kind::punctuation, begin, static_cast<size_t>(c - begin) });
+            }
+        }
+    }
+
+private:
+
+    static bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+    }
+
+    static bool is_digit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    /// @brief Identifier characters of SQLite, any byte above 0x7f is a part of UTF-8 identifier
+    static bool is_word_char(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c) || c == '_' || c == '$'
+            || static_cast<unsigned char>(c) >= 0x80;
+    }
+
+    static char to_lower(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    /// @brief Skip quoted text, where the quote is escaped by doubling it
+    static const char* skip_quoted(const char* c, char quote)
+    {
+        ++c;
+        while (*c != '\0') {
+            if (*c == quote) {
+                if (c[1] != quote) {
+                    return c + 1;
+                }
+                ++c;
+            }
+            ++c;
+        }
+        return c;
+    }
+
+    /// @brief Decimal, real with exponent or hexadecimal number
+    static const char* skip_number(const char* c)
+    {
+        if (c[0] == '0' && (c[1] == 'x' || c[1] == 'X')) {
+            c += 2;
+            while (is_digit(*c) || (to_lower(*c) >= 'a' && to_lower(*c) <= 'f')) {
+                ++c;
+            }
+            return c;
+        }
+        while (is_digit(*c)) {
+            ++c;
+        }
+        if (*c == '.') {
+            ++c;
+            while (is_digit(*c)) {
+                ++c;
+            }
+        }
+        if ((*c == 'e' || *c == 'E') && (is_digit(c[1]) || ((c[1] == '+' || c[1] == '-') && is_digit(c[2])))) {
+            c += 2;
+            while (is_digit(*c)) {
+                ++c;
+            }
+        }
+        return c;
+    }
+
+    /// @brief Length of one- or two-character operator
+    static size_t operator_size(const char* c)
+    {
+        static const char* const two_char_operators[] = { "||", "<=", ">=", "==", "!=", "<>", "<<", ">>" };
+        for (const char* op : two_char_operators) {
+            if (c[0] == op[0] && c[1] == op[1]) {
+                return 2;
+            }
+        }
+        return 1;
+    }
+
+    static bool is_in_keyword(const token& word)
+    {
+        return word.kind == token_kind::word && word.size == 2
+            && to_lower(word.begin[0]) == 'i' && to_lower(word.begin[1]) == 'n';
+    }
+
+    /// @brief Find ')' closing a list of literals, optionally signed, separated by commas
+    /// @return: index of ')', or 0 if the list has anything else, e.g. a subquery
+    static size_t literal_list_end(const std::vector<token>& tokens, size_t first)
+    {
+        bool expect_value = true;
+        for (size_t i = first; i < tokens.size(); ++i) {
+            const token& current = tokens[i];
+            const char c = current.begin[0];
+            if (current.kind == token_kind::literal && expect_value) {
+                expect_value = false;
+            }
+            else if (current.kind == token_kind::punctuation && current.size == 1 && expect_value && (c == '-' || c == '+')) {
+                continue;
+            }
+            else if (current.kind == token_kind::punctuation && current.size == 1 && !expect_value && c == ',') {
+                expect_value = true;
+            }
+            else if (current.kind == token_kind::punctuation && current.size == 1 && !expect_value && c == ')') {
+                return i;
+            }
+            else {
+                return 0;
+            }
+        }
+        return 0;
+    }
+
+    /// @brief Append token, separated by a space only if both sides are words
+    static void append(std::string& result, const token& current)
+    {
+        const bool word_like = current.kind != token_kind::punctuation;
+        if (word_like && !result.empty() && (is_word_char(result.back()) || result.back() == '?'
+            || result.back() == '"' || result.back() == '`' || result.back() == ']')) {
+            result.push_back(' ');
+        }
+        switch (current.kind) {
+        case token_kind::literal:
+            result.push_back('?');
+            break;
+        case token_kind::word:
+            for (size_t i = 0; i < current.size; ++i) {
+                result.push_back(to_lower(current.begin[i]));
+            }
+            break;
+        default:
+            result.append(current.begin, current.size);
+            break;
+        }
+    }
+};
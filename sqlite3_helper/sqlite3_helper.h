@@ -1,130 +1,2916 @@
-#include <sqlite3.h>
-
-typedef int(*sqlite3_callback)(void*, int, char**, char**);
-
-/// @brief Very lightweight header-only C++ RAII wrapper under SQlite3 ANSI C API
-/// Class does not throw exceptions. It could be considered as not C++ way, 
-/// however it increases safety in low-level application like drivers
-class sqlite3_helper
-{
-public:
-
-    /// @brief Empty-state sqlite3
-    sqlite3_helper()
-    {}
-
-    /// @brief Open or create sqlite3 database
-    sqlite3_helper(const char* database_name) :
-        current_return_code_(sqlite3_open(database_name, &db_))
-    {
-    }
-
-    /// @brief Close database handle
-    /// Important, if sqlite3_close() in close() method returned error, database remain opened
-    /// This situation may occur if database is under backup right now.
-    /// We neglect this situation, as we destroy the database object, we don't need it anymore
-    ~sqlite3_helper()
-    {
-        close();
-    }
-
-    /// No copy
-    sqlite3_helper(const sqlite3_helper&) = delete;
-
-    /// No assignment
-    sqlite3_helper& operator=(const sqlite3_helper&) = delete;
-
-    /// @brief Move c-tor leaves rhs-object in empty state
-    /// without closing the database handle
-    sqlite3_helper(sqlite3_helper&& rhs) :
-        db_(rhs.db_),
-        current_return_code_(rhs.current_return_code_)
-    {
-        db_ = rhs.db_;
-        current_return_code_ = rhs.current_return_code_;
-    }
-
-    /// @brief Assignment operator leaves rhs-object in empty state
-    /// without closing the database handle
-    sqlite3_helper& operator=(sqlite3_helper&& rhs)
-    {
-        db_ = rhs.db_;
-        current_return_code_ = rhs.current_return_code_;
-        rhs.db_ = nullptr;
-        rhs.current_return_code_ = 0;
-    }
-
-
-    /// @brief Open or create sqlite3 database
-    /// @return: SQLite error code
-    /// See https://www.sqlite.org/rescode.html for details
-    int open(const char* database_name)
-    {
-        current_return_code_ = sqlite3_open(database_name, &db_);
-        return current_return_code_;
-    }
-
-    /// @brief Close database handle
-    /// If sqlite3_close() in close() method returned error, database remain opened
-    /// It could be checked with get_last_error() and handle by the caller, 
-    /// rather than look for solution inside the method. 
-    /// Helper designed to be as lightweight as possible
-    /// @return: SQLite error code
-    /// See https://www.sqlite.org/rescode.html for details
-    int close()
-    {
-        current_return_code_ = sqlite3_close(db_);
-        if (current_return_code_ == SQLITE_OK) {
-            db_ = nullptr;
-        }
-        return current_return_code_;
-    }
-
-    /// @brief Execute SQL query
-    /// @return: SQLite error code
-    /// See https://www.sqlite.org/rescode.html for details
-    int exec(const char* sql, sqlite3_callback callback = nullptr)
-    {
-        current_return_code_ = sqlite3_exec(db_, sql, callback, nullptr, nullptr);
-        return current_return_code_;
-    }
-
-    /// @brief Is database in valid state
-    operator bool() const
-    {
-        return is_valid(); 
-    }
-
-    /// @brief Is database in valid state (handle is opened and last status is SQLITE_OK)
-    bool is_valid() const
-    {
-        return (db_ != nullptr) && (current_return_code_ == SQLITE_OK);
-    }
-
-    /// @brief Check if the current sqlite3 build is thread-safe
-    static bool is_threadsafe()
-    {
-        return sqlite3_threadsafe();
-    }
-
-    /// @brief Return last error code of any SQLite operation
-    /// If the code is not SQLITE_OK, helper is not in valid state
-    int get_last_error() const
-    { 
-        return current_return_code_; 
-    }
-
-    /// @brief Return last error message based on error code 
-    const char* get_last_error_message() const
-    {
-        return sqlite3_errstr(current_return_code_);
-    }
-
-private:
-
-    /// SQLite3 Handle
-    sqlite3* db_ = nullptr;
-
-    /// Last returned error code
-    int current_return_code_ = SQLITE_OK;
-};
+#pragma once
+
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// sqlite3_serialize() and sqlite3_deserialize() are opt-in before SQLite 3.36 and opt-out since
+#if (defined(SQLITE_ENABLE_DESERIALIZE) || SQLITE_VERSION_NUMBER >= 3036000) && !defined(SQLITE_OMIT_DESERIALIZE)
+#define SQLITE3_HELPER_DESERIALIZE
+#endif
+
+typedef int(*sqlite3_callback)(void*, int, char**, char**);
+
+/// @brief Conversion between C++ types and SQLite statement parameters/columns
+/// Specialize it to bind or extract custom types with sqlite3_helper::statement
+template <typename T, typename Enable = void>
+struct sqlite3_type_traits;
+
+/// @brief Integral types are bound and extracted as 64-bit integers
+template <typename T>
+struct sqlite3_type_traits<T, typename std::enable_if<std::is_integral<T>::value>::type>
+{
+    static int bind(sqlite3_stmt* stmt, int index, T value)
+    {
+        return sqlite3_bind_int64(stmt, index, static_cast<sqlite3_int64>(value));
+    }
+
+    static T column(sqlite3_stmt* stmt, int index)
+    {
+        return static_cast<T>(sqlite3_column_int64(stmt, index));
+    }
+};
+
+/// @brief Floating point types are bound and extracted as REAL
+template <typename T>
+struct sqlite3_type_traits<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+    static int bind(sqlite3_stmt* stmt, int index, T value)
+    {
+        return sqlite3_bind_double(stmt, index, static_cast<double>(value));
+    }
+
+    static T column(sqlite3_stmt* stmt, int index)
+    {
+        return static_cast<T>(sqlite3_column_double(stmt, index));
+    }
+};
+
+/// @brief UTF-8 text, SQLite makes its own copy of the bound value
+template <>
+struct sqlite3_type_traits<std::string>
+{
+    static int bind(sqlite3_stmt* stmt, int index, const std::string& value)
+    {
+        return sqlite3_bind_text64(stmt, index, value.data(), static_cast<sqlite3_uint64>(value.size()), SQLITE_TRANSIENT, SQLITE_UTF8);
+    }
+
+    static std::string column(sqlite3_stmt* stmt, int index)
+    {
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+        const int bytes = sqlite3_column_bytes(stmt, index);
+        return text ? std::string(text, static_cast<size_t>(bytes)) : std::string();
+    }
+};
+
+/// @brief Null-terminated UTF-8 text
+/// Extracted pointer is owned by SQLite and valid until the next step(), reset() or finalize()
+template <>
+struct sqlite3_type_traits<const char*>
+{
+    static int bind(sqlite3_stmt* stmt, int index, const char* value)
+    {
+        return value ? sqlite3_bind_text(stmt, index, value, -1, SQLITE_TRANSIENT) : sqlite3_bind_null(stmt, index);
+    }
+
+    static const char* column(sqlite3_stmt* stmt, int index)
+    {
+        return reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+    }
+};
+
+/// @brief NULL value
+template <>
+struct sqlite3_type_traits<std::nullptr_t>
+{
+    static int bind(sqlite3_stmt* stmt, int index, std::nullptr_t)
+    {
+        return sqlite3_bind_null(stmt, index);
+    }
+};
+
+/// @brief Non-const text (e.g. decayed char arrays) binds the same way as const char*
+template <>
+struct sqlite3_type_traits<char*> : sqlite3_type_traits<const char*>
+{
+};
+
+/// @brief UTF-8 text without copy on extraction
+/// Extracted view points into SQLite buffer and is valid until the next step(), reset() or finalize()
+template <>
+struct sqlite3_type_traits<std::string_view>
+{
+    static int bind(sqlite3_stmt* stmt, int index, std::string_view value)
+    {
+        // Null pointer would bind NULL instead of empty text
+        const char* data = value.data() ? value.data() : "";
+        return sqlite3_bind_text64(stmt, index, data, static_cast<sqlite3_uint64>(value.size()), SQLITE_TRANSIENT, SQLITE_UTF8);
+    }
+
+    static std::string_view column(sqlite3_stmt* stmt, int index)
+    {
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+        const int bytes = sqlite3_column_bytes(stmt, index);
+        return text ? std::string_view(text, static_cast<size_t>(bytes)) : std::string_view();
+    }
+};
+
+/// @brief Non-owning view of BLOB bytes
+/// Extracted from a column, it points into SQLite buffer and is valid
+/// until the next step(), reset() or finalize()
+struct sqlite3_blob_view
+{
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+
+    const unsigned char* begin() const
+    {
+        return data;
+    }
+
+    const unsigned char* end() const
+    {
+        return data + size;
+    }
+
+    bool empty() const
+    {
+        return size == 0;
+    }
+};
+
+/// @brief BLOB without copy on extraction
+template <>
+struct sqlite3_type_traits<sqlite3_blob_view>
+{
+    static int bind(sqlite3_stmt* stmt, int index, const sqlite3_blob_view& value)
+    {
+        return sqlite3_bind_blob64(stmt, index, value.data, static_cast<sqlite3_uint64>(value.size), SQLITE_TRANSIENT);
+    }
+
+    static sqlite3_blob_view column(sqlite3_stmt* stmt, int index)
+    {
+        sqlite3_blob_view value;
+        value.data = static_cast<const unsigned char*>(sqlite3_column_blob(stmt, index));
+        value.size = static_cast<size_t>(sqlite3_column_bytes(stmt, index));
+        return value;
+    }
+};
+
+/// @brief BLOB of zero bytes, bound without allocation (sqlite3_bind_zeroblob64)
+/// Preallocates a BLOB to be written incrementally through sqlite3_blob_stream
+struct sqlite3_zeroblob
+{
+    sqlite3_uint64 size = 0;
+};
+
+/// @brief Zero-filled BLOB parameter, could not be extracted from a column
+template <>
+struct sqlite3_type_traits<sqlite3_zeroblob>
+{
+    static int bind(sqlite3_stmt* stmt, int index, const sqlite3_zeroblob& value)
+    {
+        return sqlite3_bind_zeroblob64(stmt, index, value.size);
+    }
+};
+
+/// @brief UTF-8 text bound without copy (SQLITE_STATIC)
+/// The buffer must stay unchanged until the parameter is rebound, cleared or the statement is finalized
+struct sqlite3_static_text
+{
+    std::string_view text;
+};
+
+/// @brief BLOB bound without copy (SQLITE_STATIC)
+/// The buffer must stay unchanged until the parameter is rebound, cleared or the statement is finalized
+struct sqlite3_static_blob
+{
+    const void* data = nullptr;
+    size_t size = 0;
+};
+
+template <>
+struct sqlite3_type_traits<sqlite3_static_text>
+{
+    static int bind(sqlite3_stmt* stmt, int index, const sqlite3_static_text& value)
+    {
+        // Null pointer would bind NULL instead of empty text
+        const char* data = value.text.data() ? value.text.data() : "";
+        return sqlite3_bind_text64(stmt, index, data, static_cast<sqlite3_uint64>(value.text.size()), SQLITE_STATIC, SQLITE_UTF8);
+    }
+};
+
+template <>
+struct sqlite3_type_traits<sqlite3_static_blob>
+{
+    static int bind(sqlite3_stmt* stmt, int index, const sqlite3_static_blob& value)
+    {
+        return value.data ? sqlite3_bind_blob64(stmt, index, value.data, static_cast<sqlite3_uint64>(value.size), SQLITE_STATIC)
+            : sqlite3_bind_zeroblob64(stmt, index, 0);
+    }
+};
+
+/// @brief Owners of buffers bound without copy, released by SQLite through the bind destructor
+/// SQLite passes only the data pointer to the destructor, so owners are looked up by it
+class sqlite3_bound_buffers
+{
+public:
+
+    /// @brief Keep the owner until SQLite releases the data
+    /// @return: destructor to pass into sqlite3_bind_*()
+    static sqlite3_destructor_type keep(const void* data, std::shared_ptr<const void> owner)
+    {
+        shard& target = shard_of(data);
+        std::lock_guard<std::mutex> lock(target.mutex);
+        target.owners.emplace(data, std::move(owner));
+        return &sqlite3_bound_buffers::release;
+    }
+
+    /// @brief Number of buffers currently referenced by SQLite
+    static size_t size()
+    {
+        size_t result = 0;
+        for (size_t i = 0; i < shard_count; ++i) {
+            std::lock_guard<std::mutex> lock(shards()[i].mutex);
+            result += shards()[i].owners.size();
+        }
+        return result;
+    }
+
+private:
+
+    struct shard
+    {
+        std::mutex mutex;
+
+        /// The same buffer may be bound to several parameters at once
+        std::unordered_multimap<const void*, std::shared_ptr<const void>> owners;
+    };
+
+    static constexpr size_t shard_count = 16;
+
+    /// @brief Intentionally never destroyed, statements may be finalized during exit
+    static shard* shards()
+    {
+        static shard* result = new shard[shard_count];
+        return result;
+    }
+
+    static shard& shard_of(const void* data)
+    {
+        // Skip alignment bits of the address
+        return shards()[(reinterpret_cast<uintptr_t>(data) >> 4) % shard_count];
+    }
+
+    /// @brief Bind destructor, drops one owner reference outside the lock
+    static void release(void* data)
+    {
+        shard& target = shard_of(data);
+        std::shared_ptr<const void> owner;
+        {
+            std::lock_guard<std::mutex> lock(target.mutex);
+            const auto found = target.owners.find(data);
+            if (found != target.owners.end()) {
+                owner = std::move(found->second);
+                target.owners.erase(found);
+            }
+        }
+    }
+};
+
+/// @brief UTF-8 text bound without copy, SQLite keeps the string alive until it drops the value
+struct sqlite3_shared_text
+{
+    sqlite3_shared_text()
+    {}
+
+    /// @brief Take over the string
+    explicit sqlite3_shared_text(std::string&& text) :
+        sqlite3_shared_text(std::make_shared<const std::string>(std::move(text)))
+    {
+    }
+
+    /// @brief Share the string
+    explicit sqlite3_shared_text(std::shared_ptr<const std::string> text) :
+        data(text ? text->data() : nullptr),
+        size(text ? text->size() : 0),
+        owner(std::move(text))
+    {
+    }
+
+    const char* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> owner;
+};
+
+/// @brief BLOB bound without copy, SQLite keeps the buffer alive until it drops the value
+struct sqlite3_shared_blob
+{
+    sqlite3_shared_blob()
+    {}
+
+    /// @brief Take over the vector
+    explicit sqlite3_shared_blob(std::vector<unsigned char>&& bytes) :
+        sqlite3_shared_blob(std::make_shared<const std::vector<unsigned char>>(std::move(bytes)))
+    {
+    }
+
+    /// @brief Share the vector
+    explicit sqlite3_shared_blob(std::shared_ptr<const std::vector<unsigned char>> bytes) :
+        data(bytes ? bytes->data() : nullptr),
+        size(bytes ? bytes->size() : 0),
+        owner(std::move(bytes))
+    {
+    }
+
+    /// @brief Share any buffer, e.g. a memory-mapped file, kept alive by the owner
+    sqlite3_shared_blob(std::shared_ptr<const void> buffer_owner, const void* buffer, size_t buffer_size) :
+        data(buffer),
+        size(buffer_size),
+        owner(std::move(buffer_owner))
+    {
+    }
+
+    const void* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> owner;
+};
+
+template <>
+struct sqlite3_type_traits<sqlite3_shared_text>
+{
+    static int bind(sqlite3_stmt* stmt, int index, const sqlite3_shared_text& value)
+    {
+        if (value.data == nullptr || value.size == 0) {
+            return sqlite3_bind_text(stmt, index, "", 0, SQLITE_STATIC);
+        }
+        // On failure SQLite calls the destructor itself
+        return sqlite3_bind_text64(stmt, index, value.data, static_cast<sqlite3_uint64>(value.size),
+            sqlite3_bound_buffers::keep(value.data, value.owner), SQLITE_UTF8);
+    }
+};
+
+template <>
+struct sqlite3_type_traits<sqlite3_shared_blob>
+{
+    static int bind(sqlite3_stmt* stmt, int index, const sqlite3_shared_blob& value)
+    {
+        if (value.data == nullptr || value.size == 0) {
+            return sqlite3_bind_zeroblob64(stmt, index, 0);
+        }
+        // On failure SQLite calls the destructor itself
+        return sqlite3_bind_blob64(stmt, index, value.data, static_cast<sqlite3_uint64>(value.size),
+            sqlite3_bound_buffers::keep(value.data, value.owner));
+    }
+};
+
+/// @brief Column of the current row convertible to any type having sqlite3_type_traits specialization
+/// Used to initialize aggregate fields, so that the field type selects the extraction function
+struct sqlite3_column_reader
+{
+    sqlite3_stmt* stmt = nullptr;
+    int index = 0;
+
+    template <typename U>
+    operator U() const
+    {
+        return sqlite3_type_traits<U>::column(stmt, index);
+    }
+};
+
+/// @brief Is T brace-initializable from N columns
+template <typename T, typename Indices, typename Enable = void>
+struct sqlite3_is_initializable_from_columns : std::false_type
+{
+};
+
+template <typename T, size_t... I>
+struct sqlite3_is_initializable_from_columns<T, std::index_sequence<I...>,
+    std::void_t<decltype(T{ (static_cast<void>(I), sqlite3_column_reader())... })>> : std::true_type
+{
+};
+
+/// @brief Number of fields of aggregate T, up to Max
+template <typename T, size_t Max = 32>
+struct sqlite3_aggregate_size :
+    std::conditional_t<sqlite3_is_initializable_from_columns<T, std::make_index_sequence<Max>>::value,
+        std::integral_constant<size_t, Max>,
+        sqlite3_aggregate_size<T, Max - 1>>
+{
+};
+
+template <typename T>
+struct sqlite3_aggregate_size<T, 0> : std::integral_constant<size_t, 0>
+{
+};
+
+/// @brief Tuple of references to the fields of aggregate, up to 16 fields
+template <typename T>
+auto sqlite3_aggregate_tie(const T& value)
+{
+    constexpr size_t size = sqlite3_aggregate_size<T>::value;
+    static_assert(size <= 16, "Aggregates with more than 16 fields need sqlite3_row_traits specialization");
+    if constexpr (size == 1) { const auto& [a1] = value; return std::tie(a1); }
+    else if constexpr (size == 2) { const auto& [a1, a2] = value; return std::tie(a1, a2); }
+    else if constexpr (size == 3) { const auto& [a1, a2, a3] = value; return std::tie(a1, a2, a3); }
+    else if constexpr (size == 4) { const auto& [a1, a2, a3, a4] = value; return std::tie(a1, a2, a3, a4); }
+    else if constexpr (size == 5) { const auto& [a1, a2, a3, a4, a5] = value; return std::tie(a1, a2, a3, a4, a5); }
+    else if constexpr (size == 6) { const auto& [a1, a2, a3, a4, a5, a6] = value; return std::tie(a1, a2, a3, a4, a5, a6); }
+    else if constexpr (size == 7) { const auto& [a1, a2, a3, a4, a5, a6, a7] = value; return std::tie(a1, a2, a3, a4, a5, a6, a7); }
+    else if constexpr (size == 8) { const auto& [a1, a2, a3, a4, a5, a6, a7, a8] = value; return std::tie(a1, a2, a3, a4, a5, a6, a7, a8); }
+    else if constexpr (size == 9) {
+        const auto& [a1, a2, a3, a4, a5, a6, a7, a8, a9] = value;
+        return std::tie(a1, a2, a3, a4, a5, a6, a7, a8, a9);
+    }
+    else if constexpr (size == 10) {
+        const auto& [a1, a2, a3, a4, a5, a6, a7, a8, a9, a10] = value;
+        return std::tie(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10);
+    }
+    else if constexpr (size == 11) {
+        const auto& [a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11] = value;
+        return std::tie(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11);
+    }
+    else if constexpr (size == 12) {
+        const auto& [a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12] = value;
+        return std::tie(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12);
+    }
+    else if constexpr (size == 13) {
+        const auto& [a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13] = value;
+        return std::tie(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13);
+    }
+    else if constexpr (size == 14) {
+        const auto& [a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14] = value;
+        return std::tie(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14);
+    }
+    else if constexpr (size == 15) {
+        const auto& [a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15] = value;
+        return std::tie(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15);
+    }
+    else {
+        const auto& [a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16] = value;
+        return std::tie(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16);
+    }
+}
+
+/// @brief Bind tuple elements to consecutive parameters starting from first_index
+/// @return: SQLite error code of the first failed bind, or SQLITE_OK
+template <typename Tuple, size_t... I>
+int sqlite3_bind_tuple(sqlite3_stmt* stmt, int first_index, const Tuple& values, std::index_sequence<I...>)
+{
+    int return_code = SQLITE_OK;
+    static_cast<void>((... && ((return_code = sqlite3_type_traits<std::decay_t<std::tuple_element_t<I, Tuple>>>::bind(
+        stmt, first_index + static_cast<int>(I), std::get<I>(values))) == SQLITE_OK)));
+    return return_code;
+}
+
+/// @brief Approximate size of the value in the database record, used to limit transaction size
+template <typename T>
+size_t sqlite3_value_size(const T& value)
+{
+    if constexpr (std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value) {
+        return value.size();
+    }
+    else if constexpr (std::is_same<T, sqlite3_blob_view>::value) {
+        return value.size;
+    }
+    else if constexpr (std::is_same<T, sqlite3_zeroblob>::value) {
+        return static_cast<size_t>(value.size);
+    }
+    else if constexpr (std::is_same<T, sqlite3_static_text>::value) {
+        return value.text.size();
+    }
+    else if constexpr (std::is_same<T, sqlite3_static_blob>::value || std::is_same<T, sqlite3_shared_text>::value
+        || std::is_same<T, sqlite3_shared_blob>::value) {
+        return value.size;
+    }
+    else if constexpr (std::is_same<T, const char*>::value || std::is_same<T, char*>::value) {
+        return value ? std::strlen(value) : 0;
+    }
+    else {
+        return sizeof(T);
+    }
+}
+
+/// @brief Conversion of the current statement row into C++ type
+/// Default implementation initializes aggregate fields from the columns in declaration order,
+/// column count and extraction functions are resolved at compile time.
+/// Specialize it to map rows into non-aggregate types
+template <typename T, typename Enable = void>
+struct sqlite3_row_traits
+{
+    static_assert(std::is_aggregate<T>::value, "Row type should be aggregate, tuple, or have sqlite3_row_traits specialization");
+
+    static constexpr int column_count = static_cast<int>(sqlite3_aggregate_size<T>::value);
+
+    static T get(sqlite3_stmt* stmt)
+    {
+        return make(stmt, std::make_index_sequence<sqlite3_aggregate_size<T>::value>());
+    }
+
+    /// @brief Bind fields to consecutive parameters starting from first_index
+    static int bind(sqlite3_stmt* stmt, int first_index, const T& value)
+    {
+        return sqlite3_row_traits<decltype(sqlite3_aggregate_tie(value))>::bind(stmt, first_index, sqlite3_aggregate_tie(value));
+    }
+
+    /// @brief Approximate size of the fields in the database record
+    static size_t size(const T& value)
+    {
+        return sqlite3_row_traits<decltype(sqlite3_aggregate_tie(value))>::size(sqlite3_aggregate_tie(value));
+    }
+
+private:
+
+    template <size_t... I>
+    static T make(sqlite3_stmt* stmt, std::index_sequence<I...>)
+    {
+        return T{ sqlite3_column_reader{ stmt, static_cast<int>(I) }... };
+    }
+};
+
+/// @brief Tuple elements are extracted from the columns in order
+template <typename... Ts>
+struct sqlite3_row_traits<std::tuple<Ts...>>
+{
+    static constexpr int column_count = static_cast<int>(sizeof...(Ts));
+
+    static std::tuple<Ts...> get(sqlite3_stmt* stmt)
+    {
+        return make(stmt, std::index_sequence_for<Ts...>());
+    }
+
+    /// @brief Bind elements to consecutive parameters starting from first_index
+    static int bind(sqlite3_stmt* stmt, int first_index, const std::tuple<Ts...>& value)
+    {
+        return sqlite3_bind_tuple(stmt, first_index, value, std::index_sequence_for<Ts...>());
+    }
+
+    /// @brief Approximate size of the elements in the database record
+    static size_t size(const std::tuple<Ts...>& value)
+    {
+        return std::apply([](const auto&... element) { return (size_t(0) + ... + sqlite3_value_size(element)); }, value);
+    }
+
+private:
+
+    template <size_t... I>
+    static std::tuple<Ts...> make(sqlite3_stmt* stmt, std::index_sequence<I...>)
+    {
+        return std::tuple<Ts...>(sqlite3_type_traits<Ts>::column(stmt, static_cast<int>(I))...);
+    }
+};
+
+/// @brief Very lightweight header-only C++ RAII wrapper under SQlite3 ANSI C API
+/// Class does not throw exceptions. It could be considered as not C++ way, 
+/// however it increases safety in low-level application like drivers
+class sqlite3_helper
+{
+    class statement_cache;
+    struct statement_cache_entry;
+    struct busy_state;
+
+public:
+
+    /// @brief Retry policy when the database is locked by another connection
+    /// Sleep between retries grows exponentially with random jitter, until the deadline
+    struct busy_policy
+    {
+        /// Sleep before the first retry
+        std::chrono::microseconds initial_delay = std::chrono::microseconds(100);
+
+        /// Upper bound of the sleep between retries
+        std::chrono::microseconds max_delay = std::chrono::milliseconds(100);
+
+        /// Sleep growth factor between retries
+        double multiplier = 2.0;
+
+        /// Give up and return SQLITE_BUSY after this time since the first busy event
+        std::chrono::milliseconds timeout = std::chrono::milliseconds(5000);
+
+        /// For shared-cache connections, block in sqlite3_unlock_notify() on SQLITE_LOCKED
+        /// until the blocking transaction is finished. Requires SQLITE_ENABLE_UNLOCK_NOTIFY build
+        bool unlock_notify = true;
+    };
+
+    /// @brief Lock contention counters of the connection
+    struct busy_stats
+    {
+        /// Operations which found the database locked
+        size_t busy_events = 0;
+
+        /// Retries after sleep
+        size_t retries = 0;
+
+        /// Operations which gave up after the deadline
+        size_t timeouts = 0;
+
+        /// Waits for shared-cache unlock notification
+        size_t unlock_waits = 0;
+
+        /// Total time spent sleeping or waiting for unlock
+        std::chrono::microseconds total_wait = std::chrono::microseconds(0);
+    };
+
+    /// @brief Prepared statement cache counters
+    /// Every miss is a sqlite3_prepare_v3() call, so steady-state traffic should only produce hits
+    struct statement_cache_stats
+    {
+        /// Statements taken from the cache
+        size_t hits = 0;
+
+        /// Statements compiled because they were absent in the cache or already in use
+        size_t misses = 0;
+
+        /// Calls with empty SQL or several statements in it, which are never cached nor compiled again
+        size_t bypassed = 0;
+
+        /// Least recently used statements finalized to keep the cache within capacity
+        size_t evictions = 0;
+
+        /// Statements currently kept in the cache
+        size_t size = 0;
+
+        /// Maximum number of statements kept in the cache
+        size_t capacity = 0;
+    };
+
+    /// @brief RAII wrapper under sqlite3_stmt
+    /// Statement is compiled once and could be executed many times with different parameters,
+    /// avoiding SQL parsing and string formatting in hot loops.
+    /// As the parent class, it does not throw exceptions, check get_last_error() instead
+    class statement
+    {
+    public:
+
+        /// @brief Empty-state statement
+        statement()
+        {}
+
+        /// @brief Compile SQL statement
+        /// @param prepare_flags: SQLITE_PREPARE_* flags, see sqlite3_prepare_v3()
+        statement(const sqlite3_helper& db, const char* sql, unsigned int prepare_flags = 0) :
+            db_(db.db_),
+            busy_(db.busy_state_)
+        {
+            while ((current_return_code_ = sqlite3_prepare_v3(db_, sql, -1, prepare_flags, &stmt_, nullptr)) == SQLITE_LOCKED &&
+                wait_for_unlock() == SQLITE_OK) {
+            }
+        }
+
+        /// @brief Finalize statement handle
+        ~statement()
+        {
+            finalize();
+        }
+
+        /// No copy
+        statement(const statement&) = delete;
+
+        /// No assignment
+        statement& operator=(const statement&) = delete;
+
+        /// @brief Move c-tor leaves rhs-object in empty state
+        statement(statement&& rhs) :
+            db_(rhs.db_),
+            stmt_(rhs.stmt_),
+            cache_(std::move(rhs.cache_)),
+            cache_entry_(rhs.cache_entry_),
+            busy_(std::move(rhs.busy_)),
+            current_return_code_(rhs.current_return_code_)
+        {
+            rhs.db_ = nullptr;
+            rhs.stmt_ = nullptr;
+            rhs.cache_entry_ = nullptr;
+            rhs.current_return_code_ = SQLITE_OK;
+        }
+
+        /// @brief Move assignment finalizes own handle and leaves rhs-object in empty state
+        statement& operator=(statement&& rhs)
+        {
+            if (this != &rhs) {
+                finalize();
+                db_ = rhs.db_;
+                stmt_ = rhs.stmt_;
+                cache_ = std::move(rhs.cache_);
+                cache_entry_ = rhs.cache_entry_;
+                busy_ = std::move(rhs.busy_);
+                current_return_code_ = rhs.current_return_code_;
+                rhs.db_ = nullptr;
+                rhs.stmt_ = nullptr;
+                rhs.cache_entry_ = nullptr;
+                rhs.current_return_code_ = SQLITE_OK;
+            }
+            return *this;
+        }
+
+        /// @brief Destroy compiled statement, it could not be used anymore
+        /// Statement taken from the connection cache is reset and returned to the cache instead
+        /// @return: SQLite error code
+        int finalize()
+        {
+            if (cache_entry_ != nullptr) {
+                cache_->release(cache_entry_);
+                cache_.reset();
+                cache_entry_ = nullptr;
+                current_return_code_ = SQLITE_OK;
+            }
+            else {
+                current_return_code_ = sqlite3_finalize(stmt_);
+            }
+            stmt_ = nullptr;
+            return current_return_code_;
+        }
+
+        /// @brief Bind value to 1-based parameter index
+        /// Any type having sqlite3_type_traits specialization could be bound
+        /// @return: SQLite error code
+        template <typename T>
+        int bind(int index, const T& value)
+        {
+            current_return_code_ = sqlite3_type_traits<typename std::decay<T>::type>::bind(stmt_, index, value);
+            return current_return_code_;
+        }
+
+        /// @brief Bind value to named parameter, e.g. ":name", "@name" or "$name"
+        /// @return: SQLite error code
+        template <typename T>
+        int bind(const char* name, const T& value)
+        {
+            const int index = sqlite3_bind_parameter_index(stmt_, name);
+            if (index == 0) {
+                current_return_code_ = SQLITE_RANGE;
+                return current_return_code_;
+            }
+            return bind(index, value);
+        }
+
+        /// @brief Bind all parameters in order, starting from index 1
+        /// @return: SQLite error code of the first failed bind, or SQLITE_OK
+        template <typename... Args>
+        int bind_all(const Args&... args)
+        {
+            return bind_from(1, args...);
+        }
+
+        /// @brief Reset all parameters to NULL
+        /// @return: SQLite error code
+        int clear_bindings()
+        {
+            current_return_code_ = sqlite3_clear_bindings(stmt_);
+            return current_return_code_;
+        }
+
+        /// @brief Evaluate statement until the next row is available
+        /// @return: SQLITE_ROW if a new row is ready, SQLITE_DONE if finished, or error code
+        /// Last error becomes SQLITE_OK for both SQLITE_ROW and SQLITE_DONE
+        int step()
+        {
+            int step_code = SQLITE_OK;
+            while ((step_code = sqlite3_step(stmt_)) == SQLITE_LOCKED && wait_for_unlock() == SQLITE_OK) {
+                sqlite3_reset(stmt_);
+            }
+            current_return_code_ = (step_code == SQLITE_ROW || step_code == SQLITE_DONE) ? SQLITE_OK : step_code;
+            return step_code;
+        }
+
+        /// @brief Reset statement to be executed again, bound parameters are retained
+        /// @return: SQLite error code
+        int reset()
+        {
+            current_return_code_ = sqlite3_reset(stmt_);
+            return current_return_code_;
+        }
+
+        /// @brief Reset, bind all parameters and run statement to completion
+        /// Convenient for INSERT/UPDATE/DELETE statements executed in a loop
+        /// @return: SQLite error code
+        template <typename... Args>
+        int exec(const Args&... args)
+        {
+            if (reset() != SQLITE_OK || bind_all(args...) != SQLITE_OK) {
+                return current_return_code_;
+            }
+            while (step() == SQLITE_ROW) {}
+            return current_return_code_;
+        }
+
+        /// @brief Extract value from 0-based column of the current row
+        /// Any type having sqlite3_type_traits specialization could be extracted
+        template <typename T>
+        T column(int index) const
+        {
+            return sqlite3_type_traits<T>::column(stmt_, index);
+        }
+
+        /// @brief Is the column of the current row NULL
+        bool is_null(int index) const
+        {
+            return sqlite3_column_type(stmt_, index) == SQLITE_NULL;
+        }
+
+        /// @brief Number of columns in the result set
+        int column_count() const
+        {
+            return sqlite3_column_count(stmt_);
+        }
+
+        /// @brief Column name as it appears in the result set
+        const char* column_name(int index) const
+        {
+            return sqlite3_column_name(stmt_, index);
+        }
+
+        /// @brief Underlying statement handle, owned by the object
+        sqlite3_stmt* handle() const
+        {
+            return stmt_;
+        }
+
+        /// @brief Is statement in valid state
+        operator bool() const
+        {
+            return is_valid();
+        }
+
+        /// @brief Is statement in valid state (compiled and last status is SQLITE_OK)
+        bool is_valid() const
+        {
+            return (stmt_ != nullptr) && (current_return_code_ == SQLITE_OK);
+        }
+
+        /// @brief Return last error code of any statement operation
+        int get_last_error() const
+        {
+            return current_return_code_;
+        }
+
+        /// @brief Return last error message based on error code
+        const char* get_last_error_message() const
+        {
+            return sqlite3_errstr(current_return_code_);
+        }
+
+    private:
+
+        friend class sqlite3_helper;
+
+        /// @brief Statement borrowed from the connection cache
+        statement(sqlite3* db, std::shared_ptr<statement_cache> cache, statement_cache_entry* entry, sqlite3_stmt* stmt, std::shared_ptr<busy_state> busy) :
+            db_(db),
+            stmt_(stmt),
+            cache_(std::move(cache)),
+            cache_entry_(entry),
+            busy_(std::move(busy))
+        {
+        }
+
+        /// @brief Block until a shared-cache lock is released, if the busy policy allows it
+        /// @return: SQLITE_OK if the operation should be retried
+        int wait_for_unlock()
+        {
+            if (busy_ == nullptr || !busy_->policy.unlock_notify ||
+                sqlite3_extended_errcode(db_) != SQLITE_LOCKED_SHAREDCACHE) {
+                return SQLITE_LOCKED;
+            }
+            return busy_->wait_for_unlock(db_);
+        }
+
+        /// Recursion end for bind_all()
+        int bind_from(int)
+        {
+            return current_return_code_ = SQLITE_OK;
+        }
+
+        template <typename T, typename... Args>
+        int bind_from(int index, const T& value, const Args&... args)
+        {
+            if (bind(index, value) != SQLITE_OK) {
+                return current_return_code_;
+            }
+            return bind_from(index + 1, args...);
+        }
+
+        /// Parent database handle, not owned
+        sqlite3* db_ = nullptr;
+
+        /// SQLite3 statement handle
+        sqlite3_stmt* stmt_ = nullptr;
+
+        /// Owning cache, if statement is borrowed from it; kept alive until the statement is returned
+        std::shared_ptr<statement_cache> cache_;
+
+        /// Cache slot the statement should be returned to
+        statement_cache_entry* cache_entry_ = nullptr;
+
+        /// Busy policy and counters of the connection at the time of preparation, kept alive by the statement
+        std::shared_ptr<busy_state> busy_;
+
+        /// Last returned error code
+        int current_return_code_ = SQLITE_OK;
+    };
+
+    /// @brief Current row of a stepped statement
+    /// Lightweight view, columns are read directly from SQLite buffers with no conversion
+    /// through text and no heap allocation. Text and BLOB views are valid until the next step
+    class row
+    {
+    public:
+
+        explicit row(sqlite3_stmt* stmt) :
+            stmt_(stmt)
+        {
+        }
+
+        /// @brief Extract value from 0-based column
+        /// Any type having sqlite3_type_traits specialization could be extracted
+        template <typename T>
+        T get(int index) const
+        {
+            return sqlite3_type_traits<T>::column(stmt_, index);
+        }
+
+        sqlite3_int64 get_int64(int index) const
+        {
+            return sqlite3_column_int64(stmt_, index);
+        }
+
+        double get_double(int index) const
+        {
+            return sqlite3_column_double(stmt_, index);
+        }
+
+        std::string_view get_text(int index) const
+        {
+            return sqlite3_type_traits<std::string_view>::column(stmt_, index);
+        }
+
+        sqlite3_blob_view get_blob(int index) const
+        {
+            return sqlite3_type_traits<sqlite3_blob_view>::column(stmt_, index);
+        }
+
+        /// @brief Fundamental datatype of the column: SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT, SQLITE_BLOB or SQLITE_NULL
+        int type(int index) const
+        {
+            return sqlite3_column_type(stmt_, index);
+        }
+
+        bool is_null(int index) const
+        {
+            return type(index) == SQLITE_NULL;
+        }
+
+        /// @brief Number of columns in the row
+        int size() const
+        {
+            return sqlite3_column_count(stmt_);
+        }
+
+        const char* name(int index) const
+        {
+            return sqlite3_column_name(stmt_, index);
+        }
+
+        /// @brief Convert the whole row into tuple, aggregate or any type having sqlite3_row_traits specialization
+        template <typename T>
+        T as() const
+        {
+            return sqlite3_row_traits<T>::get(stmt_);
+        }
+
+    private:
+
+        /// Statement handle, not owned
+        sqlite3_stmt* stmt_ = nullptr;
+    };
+
+    /// @brief Result set of query(), single-pass range of rows
+    /// for (auto row : db.query("SELECT filename, entropy FROM files WHERE entropy > ?", 5.0))
+    /// Step errors are stored in the parent helper and could be checked with get_last_error()
+    class query_result
+    {
+    public:
+
+        /// @brief Input iterator, every increment steps the statement
+        class iterator
+        {
+        public:
+
+            using iterator_category = std::input_iterator_tag;
+            using value_type = row;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const row*;
+            using reference = row;
+
+            iterator()
+            {}
+
+            explicit iterator(query_result* result) :
+                result_(result)
+            {
+            }
+
+            row operator*() const
+            {
+                return row(result_->stmt_.handle());
+            }
+
+            iterator& operator++()
+            {
+                if (!result_->step()) {
+                    result_ = nullptr;
+                }
+                return *this;
+            }
+
+            bool operator==(const iterator& rhs) const
+            {
+                return result_ == rhs.result_;
+            }
+
+            bool operator!=(const iterator& rhs) const
+            {
+                return result_ != rhs.result_;
+            }
+
+        private:
+
+            /// nullptr for the end iterator
+            query_result* result_ = nullptr;
+        };
+
+        query_result(sqlite3_helper* db, statement&& stmt) :
+            db_(db),
+            stmt_(std::move(stmt))
+        {
+        }
+
+        /// @brief Step to the first row
+        iterator begin()
+        {
+            return step() ? iterator(this) : iterator();
+        }
+
+        iterator end()
+        {
+            return iterator();
+        }
+
+        /// @brief Statement the rows are read from
+        statement& get_statement()
+        {
+            return stmt_;
+        }
+
+    private:
+
+        /// @return true if a new row is available
+        bool step()
+        {
+            if (stmt_.handle() == nullptr) {
+                return false;
+            }
+            const int step_code = stmt_.step();
+            if (step_code != SQLITE_ROW && step_code != SQLITE_DONE) {
+                db_->current_return_code_ = step_code;
+            }
+            return step_code == SQLITE_ROW;
+        }
+
+        /// Parent helper receiving step errors
+        sqlite3_helper* db_ = nullptr;
+
+        /// Statement, returned to the connection cache on destruction
+        statement stmt_;
+    };
+
+    /// @brief Per-connection lookaside memory: small allocations of parsing and statement execution
+    /// are served from preallocated slots instead of malloc, see https://www.sqlite.org/malloc.html#lookaside
+    struct lookaside_config
+    {
+        /// Slot size in bytes, rounded down to a multiple of 8 by SQLite; larger allocations go to malloc
+        int slot_size = 1200;
+
+        /// Number of slots, 0 disables lookaside
+        int slot_count = 100;
+    };
+
+    /// @brief Connection open flags and settings applied right after the database is opened
+    /// Unset values keep SQLite defaults, see https://www.sqlite.org/pragma.html
+    struct open_options
+    {
+        /// SQLITE_OPEN_* flags, e.g. SQLITE_OPEN_NOMUTEX to avoid serialized mode locking
+        /// if the connection is used by one thread at a time
+        int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+        /// VFS module name, nullptr for the default one
+        const char* vfs = nullptr;
+
+        /// PRAGMA journal_mode: "DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL" or "OFF"
+        /// open() fails with SQLITE_ERROR if the mode did not take effect, e.g. WAL for in-memory database
+        const char* journal_mode = nullptr;
+
+        /// PRAGMA synchronous: "OFF", "NORMAL", "FULL" or "EXTRA"
+        const char* synchronous = nullptr;
+
+        /// PRAGMA temp_store: "DEFAULT", "FILE" or "MEMORY"
+        const char* temp_store = nullptr;
+
+        /// PRAGMA cache_size: pages if positive, KiB if negative
+        std::optional<int> cache_size;
+
+        /// PRAGMA mmap_size in bytes, 0 disables memory-mapped I/O
+        std::optional<sqlite3_int64> mmap_size;
+
+        /// PRAGMA page_size in bytes, takes effect only for a new database or after VACUUM,
+        /// and can't be changed in WAL mode
+        std::optional<int> page_size;
+
+        /// sqlite3_busy_timeout() in milliseconds
+        std::optional<int> busy_timeout;
+
+        /// Lookaside memory of the connection, SQLite default if not set
+        std::optional<lookaside_config> lookaside;
+
+        /// @brief Fast initial population of a database: no durability, large cache
+        /// Database may be corrupted if the process or OS crashes during the load
+        static open_options bulk_load()
+        {
+            open_options options;
+            options.journal_mode = "MEMORY";
+            options.synchronous = "OFF";
+            options.temp_store = "MEMORY";
+            options.cache_size = -256 * 1024;
+            return options;
+        }
+
+        /// @brief Mostly read workload: WAL for concurrent readers, memory-mapped I/O and larger cache
+        static open_options read_mostly()
+        {
+            open_options options;
+            options.journal_mode = "WAL";
+            options.synchronous = "NORMAL";
+            options.temp_store = "MEMORY";
+            options.cache_size = -64 * 1024;
+            options.mmap_size = 256 * 1024 * 1024;
+            options.busy_timeout = 5000;
+            return options;
+        }
+
+        /// @brief Transactional workload where every commit should survive power loss
+        static open_options durable_oltp()
+        {
+            open_options options;
+            options.journal_mode = "WAL";
+            options.synchronous = "FULL";
+            options.cache_size = -16 * 1024;
+            options.busy_timeout = 5000;
+            return options;
+        }
+    };
+
+    /// @brief Memory-mapped I/O state of one database file
+    struct mmap_status
+    {
+        /// Current mmap_size limit of the file in bytes, 0 if memory-mapped I/O is disabled
+        sqlite3_int64 limit = 0;
+
+        /// Database file size in bytes
+        sqlite3_int64 file_size = 0;
+
+        /// Bytes of the file accessed through the mapping, min(limit, file_size).
+        /// SQLite maps the file lazily, on the first read transaction after the limit is set
+        sqlite3_int64 mapped = 0;
+    };
+
+    /// @brief Current value and high-water mark of a status counter
+    struct status_value
+    {
+        sqlite3_int64 current = 0;
+        sqlite3_int64 highwater = 0;
+    };
+
+    /// @brief Memory and cache counters of the connection (sqlite3_db_status)
+    /// and of the whole process (sqlite3_status64)
+    struct statistics
+    {
+        /// Page cache hits, misses, pages written and written in the middle of a transaction (spills)
+        sqlite3_int64 cache_hit = 0;
+        sqlite3_int64 cache_miss = 0;
+        sqlite3_int64 cache_write = 0;
+        sqlite3_int64 cache_spill = 0;
+
+        /// Bytes of page cache used by the connection, and the shared-cache part divided between connections
+        sqlite3_int64 cache_used = 0;
+        sqlite3_int64 cache_used_shared = 0;
+
+        /// Lookaside slots in use; allocations served from lookaside, and missed as too large or when it was full
+        status_value lookaside_used;
+        sqlite3_int64 lookaside_hit = 0;
+        sqlite3_int64 lookaside_miss_size = 0;
+        sqlite3_int64 lookaside_miss_full = 0;
+
+        /// Bytes used by schemas and prepared statements of the connection
+        sqlite3_int64 schema_used = 0;
+        sqlite3_int64 statement_used = 0;
+
+        /// Process-wide: bytes allocated by SQLite, outstanding allocations and the largest allocation request
+        status_value memory_used;
+        status_value malloc_count;
+        sqlite3_int64 malloc_size_highwater = 0;
+
+        /// Process-wide: pages of SQLITE_CONFIG_PAGECACHE memory used, bytes which did not fit there,
+        /// and the largest page cache allocation request
+        status_value pagecache_used;
+        status_value pagecache_overflow;
+        sqlite3_int64 pagecache_size_highwater = 0;
+    };
+
+    /// @brief Progress of an online backup
+    struct backup_progress
+    {
+        /// Pages of the source database, and pages left to copy
+        int page_count = 0;
+        int remaining = 0;
+
+        /// Times the backup started over, as the source was modified by another connection
+        int restarts = 0;
+    };
+
+    /// @brief Online backup settings
+    /// Source is read-locked only during a step, so writers proceed between steps
+    struct backup_options
+    {
+        /// Pages copied per step, negative to copy the whole database in one step
+        int pages_per_step = 256;
+
+        /// Pause between steps, caps I/O at about pages_per_step * page_size per step_delay;
+        /// zero only yields the thread
+        std::chrono::milliseconds step_delay = std::chrono::milliseconds(0);
+
+        /// Give up with SQLITE_BUSY if no page could be copied for this time, as the source or destination is locked
+        std::chrono::milliseconds busy_timeout = std::chrono::milliseconds(5000);
+
+        /// After this number of restarts the rest of the database is copied in one step, so that
+        /// the backup finishes under constant writes. A WAL source keeps accepting writes meanwhile,
+        /// otherwise writers wait until the copy is done. Negative to keep restarting
+        int max_restarts = 4;
+
+        /// Source and destination schema: "main", "temp" or attached database name
+        const char* source_schema = "main";
+        const char* destination_schema = "main";
+
+        /// Called after every step, returning false aborts the backup with SQLITE_ABORT
+        /// and leaves the destination unchanged
+        std::function<bool(const backup_progress&)> progress;
+    };
+
+    /// @brief Serialized database: the same bytes as the database file, in memory owned by SQLite allocator
+    class image
+    {
+    public:
+
+        /// @brief Empty image
+        image()
+        {}
+
+        ~image()
+        {
+            sqlite3_free(data_);
+        }
+
+        image(const image&) = delete;
+        image& operator=(const image&) = delete;
+
+        /// @brief Move c-tor leaves rhs-object empty
+        image(image&& rhs) :
+            data_(rhs.data_),
+            size_(rhs.size_)
+        {
+            rhs.data_ = nullptr;
+            rhs.size_ = 0;
+        }
+
+        /// @brief Move assignment frees own buffer and leaves rhs-object empty
+        image& operator=(image&& rhs)
+        {
+            if (this != &rhs) {
+                sqlite3_free(data_);
+                data_ = rhs.data_;
+                size_ = rhs.size_;
+                rhs.data_ = nullptr;
+                rhs.size_ = 0;
+            }
+            return *this;
+        }
+
+        const unsigned char* data() const
+        {
+            return data_;
+        }
+
+        sqlite3_int64 size() const
+        {
+            return size_;
+        }
+
+        bool empty() const
+        {
+            return size_ == 0;
+        }
+
+        /// @brief Write the image as a database file snapshot, replacing the file, see sqlite3_helper::write_file()
+        /// @return: SQLite error code
+        int save(const char* file_name) const
+        {
+            return write_file(file_name, data_, static_cast<size_t>(size_));
+        }
+
+        /// @brief Read a database file, e.g. a snapshot written by save()
+        /// @return: SQLite error code
+        int load(const char* file_name)
+        {
+            std::FILE* file = std::fopen(file_name, "rb");
+            if (file == nullptr) {
+                return SQLITE_CANTOPEN;
+            }
+            int return_code = SQLITE_OK;
+            unsigned char* data = nullptr;
+            long size = -1;
+            if (std::fseek(file, 0, SEEK_END) != 0 || (size = std::ftell(file)) < 0 || std::fseek(file, 0, SEEK_SET) != 0) {
+                return_code = SQLITE_IOERR;
+            }
+            else if (size > 0 && (data = static_cast<unsigned char*>(sqlite3_malloc64(static_cast<sqlite3_uint64>(size)))) == nullptr) {
+                return_code = SQLITE_NOMEM;
+            }
+            else if (std::fread(data, 1, static_cast<size_t>(size), file) != static_cast<size_t>(size)) {
+                return_code = SQLITE_IOERR;
+            }
+            std::fclose(file);
+            if (return_code != SQLITE_OK) {
+                sqlite3_free(data);
+                return return_code;
+            }
+            *this = image(data, size);
+            return SQLITE_OK;
+        }
+
+    private:
+
+        friend class sqlite3_helper;
+
+        image(unsigned char* data, sqlite3_int64 size) :
+            data_(data),
+            size_(size)
+        {
+        }
+
+        /// Buffer allocated by sqlite3_malloc64(), nullptr for empty image
+        unsigned char* data_ = nullptr;
+        sqlite3_int64 size_ = 0;
+    };
+
+    /// @brief Locking behavior of the outermost transaction, see https://www.sqlite.org/lang_transaction.html
+    enum class transaction_mode
+    {
+        /// Locks are acquired on the first read or write
+        deferred,
+
+        /// Write lock is acquired immediately, other connections still could read
+        immediate,
+
+        /// Write lock is acquired immediately, in rollback journal mode readers are blocked as well
+        exclusive
+    };
+
+    /// @brief RAII transaction guard, rolls back on scope exit unless committed
+    /// The outermost guard issues BEGIN, nested guards (or guards created inside
+    /// a transaction started by plain SQL) map to SAVEPOINT, so they could be committed
+    /// or rolled back independently. As the parent class, it does not throw exceptions
+    class transaction
+    {
+    public:
+
+        /// @brief Begin transaction or savepoint
+        /// @param mode: ignored for nested transactions
+        explicit transaction(sqlite3_helper& db, transaction_mode mode = transaction_mode::deferred) :
+            db_(&db)
+        {
+            const bool nested = (db_->transaction_depth_ > 0) || !sqlite3_get_autocommit(db_->db_);
+            if (nested) {
+                savepoint_ = "sqlite3_helper_savepoint_" + std::to_string(db_->transaction_depth_ + 1);
+                current_return_code_ = db_->exec(("SAVEPOINT " + savepoint_).c_str());
+            }
+            else {
+                const char* begin = (mode == transaction_mode::immediate) ? "BEGIN IMMEDIATE" :
+                    (mode == transaction_mode::exclusive) ? "BEGIN EXCLUSIVE" : "BEGIN DEFERRED";
+                current_return_code_ = db_->exec(begin);
+            }
+            if (current_return_code_ == SQLITE_OK) {
+                active_ = true;
+                ++db_->transaction_depth_;
+            }
+        }
+
+        /// @brief Roll back if neither committed nor rolled back
+        ~transaction()
+        {
+            rollback();
+        }
+
+        /// No copy
+        transaction(const transaction&) = delete;
+
+        /// No assignment
+        transaction& operator=(const transaction&) = delete;
+
+        /// @brief Move c-tor leaves rhs-object inactive
+        transaction(transaction&& rhs) :
+            db_(rhs.db_),
+            savepoint_(std::move(rhs.savepoint_)),
+            active_(rhs.active_),
+            current_return_code_(rhs.current_return_code_)
+        {
+            rhs.active_ = false;
+        }
+
+        /// @brief Make changes permanent (COMMIT or RELEASE savepoint)
+        /// If commit failed (e.g. SQLITE_BUSY), transaction remains active and could be committed again
+        /// @return: SQLite error code
+        int commit()
+        {
+            if (!active_) {
+                current_return_code_ = SQLITE_MISUSE;
+                return current_return_code_;
+            }
+            current_return_code_ = savepoint_.empty() ?
+                db_->exec("COMMIT") :
+                db_->exec(("RELEASE " + savepoint_).c_str());
+            if (current_return_code_ == SQLITE_OK) {
+                finish();
+            }
+            return current_return_code_;
+        }
+
+        /// @brief Discard changes (ROLLBACK or ROLLBACK TO and RELEASE savepoint)
+        /// Does nothing if the transaction is not active
+        /// @return: SQLite error code
+        int rollback()
+        {
+            if (!active_) {
+                return SQLITE_OK;
+            }
+            if (savepoint_.empty()) {
+                current_return_code_ = db_->exec("ROLLBACK");
+            }
+            else {
+                current_return_code_ = db_->exec(("ROLLBACK TO " + savepoint_).c_str());
+                const int release_code = db_->exec(("RELEASE " + savepoint_).c_str());
+                current_return_code_ = (current_return_code_ == SQLITE_OK) ? release_code : current_return_code_;
+            }
+            // Even if ROLLBACK failed, SQLite has already rolled back, or the transaction is gone
+            finish();
+            return current_return_code_;
+        }
+
+        /// @brief Is transaction started and neither committed nor rolled back
+        bool is_active() const
+        {
+            return active_;
+        }
+
+        /// @brief Is this guard a savepoint inside an outer transaction
+        bool is_nested() const
+        {
+            return !savepoint_.empty();
+        }
+
+        /// @brief Is transaction active and last status is SQLITE_OK
+        operator bool() const
+        {
+            return active_ && (current_return_code_ == SQLITE_OK);
+        }
+
+        /// @brief Return last error code of BEGIN, COMMIT or ROLLBACK
+        int get_last_error() const
+        {
+            return current_return_code_;
+        }
+
+        /// @brief Return last error message based on error code
+        const char* get_last_error_message() const
+        {
+            return sqlite3_errstr(current_return_code_);
+        }
+
+    private:
+
+        void finish()
+        {
+            active_ = false;
+            --db_->transaction_depth_;
+        }
+
+        /// Parent database
+        sqlite3_helper* db_ = nullptr;
+
+        /// Savepoint name, empty for the outermost transaction
+        std::string savepoint_;
+
+        /// Started and neither committed nor rolled back
+        bool active_ = false;
+
+        /// Last returned error code
+        int current_return_code_ = SQLITE_OK;
+    };
+
+    /// @brief Batching limits of bulk_inserter
+    struct bulk_insert_options
+    {
+        /// Commit after this number of rows
+        size_t rows_per_transaction = 100000;
+
+        /// Commit after approximately this number of bytes of row data
+        size_t bytes_per_transaction = 64 * 1024 * 1024;
+
+        /// Rows in one multi-row INSERT statement, always limited by SQLITE_LIMIT_VARIABLE_NUMBER.
+        /// 0 means as many as the limit allows, however very long statements are slower to compile and step
+        size_t rows_per_statement = 256;
+    };
+
+    /// @brief Fast insertion of many rows into one table
+    /// Rows are inserted with a prepared multi-row INSERT ... VALUES (?,?),(?,?)... statement
+    /// sized to the bound parameters limit, and grouped into transactions committed
+    /// by row count or byte size threshold. Remaining rows are flushed on destruction.
+    /// If the connection is already inside a transaction, inserter does not begin or commit its own.
+    /// On error the inserter rolls back its own transaction, rows of the caller's transaction are left to the caller
+    /// Row is a tuple, an aggregate or any type having sqlite3_row_traits specialization with bind() and size()
+    template <typename Row>
+    class bulk_inserter
+    {
+    public:
+
+        /// @brief Prepare multi-row INSERT statement
+        /// @param table: table name
+        /// @param columns: column names in the order of Row fields, all table columns if empty
+        bulk_inserter(sqlite3_helper& db, const std::string& table,
+            const std::vector<std::string>& columns = std::vector<std::string>(),
+            const bulk_insert_options& options = bulk_insert_options()) :
+            db_(db),
+            options_(options)
+        {
+            if (!columns.empty() && columns.size() != column_count) {
+                current_return_code_ = SQLITE_MISUSE;
+                return;
+            }
+
+            sql_prefix_ = "INSERT INTO " + table;
+            if (!columns.empty()) {
+                sql_prefix_ += '(';
+                for (size_t i = 0; i < columns.size(); ++i) {
+                    sql_prefix_ += (i == 0) ? "" : ",";
+                    sql_prefix_ += columns[i];
+                }
+                sql_prefix_ += ')';
+            }
+            sql_prefix_ += " VALUES ";
+
+            const int max_variables = sqlite3_limit(db_.db_, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+            rows_per_statement_ = std::max<size_t>(1, static_cast<size_t>(max_variables > 0 ? max_variables : 1) / column_count);
+            if (options_.rows_per_statement != 0) {
+                rows_per_statement_ = std::min(rows_per_statement_, options_.rows_per_statement);
+            }
+            pending_.reserve(rows_per_statement_);
+            current_return_code_ = prepare(insert_, rows_per_statement_);
+        }
+
+        /// @brief Flush remaining rows and commit
+        ~bulk_inserter()
+        {
+            flush();
+        }
+
+        bulk_inserter(const bulk_inserter&) = delete;
+        bulk_inserter& operator=(const bulk_inserter&) = delete;
+
+        /// @brief Queue row for insertion, full batch is inserted immediately
+        /// @return: SQLite error code
+        int add(const Row& row)
+        {
+            pending_.push_back(row);
+            return added();
+        }
+
+        /// @brief Queue row for insertion without copy
+        /// @return: SQLite error code
+        int add(Row&& row)
+        {
+            pending_.push_back(std::move(row));
+            return added();
+        }
+
+        /// @brief Insert queued rows and commit own transaction, or roll it back after an error
+        /// @return: SQLite error code
+        int flush()
+        {
+            if (current_return_code_ == SQLITE_OK && !pending_.empty()) {
+                if (pending_.size() == rows_per_statement_) {
+                    insert_batch(insert_);
+                }
+                else {
+                    statement tail;
+                    if ((current_return_code_ = prepare(tail, pending_.size())) == SQLITE_OK) {
+                        insert_batch(tail);
+                    }
+                }
+            }
+            commit();
+            return current_return_code_;
+        }
+
+        /// @brief Rows inserted so far, not counting queued ones and rolled back ones
+        size_t get_rows_inserted() const
+        {
+            return rows_inserted_;
+        }
+
+        /// @brief Rows in one multi-row INSERT statement
+        size_t get_rows_per_statement() const
+        {
+            return rows_per_statement_;
+        }
+
+        /// @brief Is inserter in valid state
+        operator bool() const
+        {
+            return current_return_code_ == SQLITE_OK;
+        }
+
+        /// @brief Return last error code, once an error occurred rows are not inserted anymore
+        int get_last_error() const
+        {
+            return current_return_code_;
+        }
+
+        /// @brief Return last error message based on error code
+        const char* get_last_error_message() const
+        {
+            return sqlite3_errstr(current_return_code_);
+        }
+
+    private:
+
+        static constexpr size_t column_count = static_cast<size_t>(sqlite3_row_traits<Row>::column_count);
+        static_assert(column_count > 0, "Row should have at least one field");
+
+        int prepare(statement& stmt, size_t rows)
+        {
+            std::string sql;
+            sql.reserve(sql_prefix_.size() + rows * (column_count * 2 + 3));
+            sql += sql_prefix_;
+            for (size_t row = 0; row < rows; ++row) {
+                sql += (row == 0) ? "(" : ",(";
+                for (size_t column = 0; column < column_count; ++column) {
+                    sql += (column == 0) ? "?" : ",?";
+                }
+                sql += ')';
+            }
+            stmt = statement(db_, sql.c_str(), SQLITE_PREPARE_PERSISTENT);
+            return stmt.get_last_error();
+        }
+
+        int added()
+        {
+            if (current_return_code_ != SQLITE_OK) {
+                pending_.clear();
+                return current_return_code_;
+            }
+            pending_bytes_ += sqlite3_row_traits<Row>::size(pending_.back());
+            if (pending_.size() < rows_per_statement_) {
+                return current_return_code_;
+            }
+            // Failed batch rolls back own transaction, so the connection is not left inside it
+            if (insert_batch(insert_) != SQLITE_OK ||
+                transaction_rows_ >= options_.rows_per_transaction || transaction_bytes_ >= options_.bytes_per_transaction) {
+                commit();
+            }
+            return current_return_code_;
+        }
+
+        int insert_batch(statement& stmt)
+        {
+            if (!in_transaction_ && sqlite3_get_autocommit(db_.db_)) {
+                if ((current_return_code_ = sqlite3_exec(db_.db_, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr)) != SQLITE_OK) {
+                    pending_.clear();
+                    return current_return_code_;
+                }
+                in_transaction_ = true;
+            }
+
+            int index = 1;
+            for (const Row& row : pending_) {
+                if ((current_return_code_ = sqlite3_row_traits<Row>::bind(stmt.handle(), index, row)) != SQLITE_OK) {
+                    break;
+                }
+                index += static_cast<int>(column_count);
+            }
+            if (current_return_code_ == SQLITE_OK && stmt.step() == SQLITE_DONE) {
+                rows_inserted_ += pending_.size();
+                transaction_rows_ += pending_.size();
+                transaction_bytes_ += pending_bytes_;
+            }
+            current_return_code_ = (current_return_code_ == SQLITE_OK) ? stmt.get_last_error() : current_return_code_;
+            stmt.reset();
+            pending_.clear();
+            pending_bytes_ = 0;
+            return current_return_code_;
+        }
+
+        /// Commit own transaction, or roll it back if an error occurred
+        void commit()
+        {
+            if (in_transaction_) {
+                const bool failed = (current_return_code_ != SQLITE_OK);
+                const int return_code = sqlite3_exec(db_.db_, failed ? "ROLLBACK" : "COMMIT", nullptr, nullptr, nullptr);
+                if (failed || return_code != SQLITE_OK) {
+                    rows_inserted_ -= transaction_rows_;
+                }
+                if (return_code != SQLITE_OK && !sqlite3_get_autocommit(db_.db_)) {
+                    // Failed COMMIT (e.g. SQLITE_BUSY) keeps the transaction open
+                    sqlite3_exec(db_.db_, "ROLLBACK", nullptr, nullptr, nullptr);
+                }
+                current_return_code_ = failed ? current_return_code_ : return_code;
+                in_transaction_ = false;
+            }
+            transaction_rows_ = 0;
+            transaction_bytes_ = 0;
+        }
+
+        /// Parent database
+        sqlite3_helper& db_;
+
+        /// Batching limits
+        bulk_insert_options options_;
+
+        /// "INSERT INTO table(columns) VALUES "
+        std::string sql_prefix_;
+
+        /// Full batch statement
+        statement insert_;
+
+        /// Rows in full batch statement
+        size_t rows_per_statement_ = 1;
+
+        /// Rows waiting for the next batch
+        std::vector<Row> pending_;
+
+        /// Approximate size of rows waiting for the next batch
+        size_t pending_bytes_ = 0;
+
+        /// Rows and bytes inserted in the current transaction
+        size_t transaction_rows_ = 0;
+        size_t transaction_bytes_ = 0;
+
+        /// Total rows inserted
+        size_t rows_inserted_ = 0;
+
+        /// Transaction was started by the inserter
+        bool in_transaction_ = false;
+
+        /// Last returned error code
+        int current_return_code_ = SQLITE_OK;
+    };
+
+    /// @brief Empty-state sqlite3
+    sqlite3_helper()
+    {}
+
+    /// @brief Open or create sqlite3 database
+    sqlite3_helper(const char* database_name) :
+        current_return_code_(sqlite3_open(database_name, &db_))
+    {
+    }
+
+    /// @brief Open sqlite3 database with SQLITE_OPEN_* flags and optional VFS name
+    sqlite3_helper(const char* database_name, int flags, const char* vfs = nullptr) :
+        current_return_code_(sqlite3_open_v2(database_name, &db_, flags, vfs))
+    {
+    }
+
+    /// @brief Open sqlite3 database and apply connection settings
+    sqlite3_helper(const char* database_name, const open_options& options)
+    {
+        open(database_name, options);
+    }
+
+    /// @brief Close database handle
+    /// Connection still used by borrowed statements or an unfinished backup is closed
+    /// when they are finished, see close()
+    ~sqlite3_helper()
+    {
+        close();
+    }
+
+    /// No copy
+    sqlite3_helper(const sqlite3_helper&) = delete;
+
+    /// No assignment
+    sqlite3_helper& operator=(const sqlite3_helper&) = delete;
+
+    /// @brief Move c-tor leaves rhs-object in empty state
+    /// without closing the database handle
+    sqlite3_helper(sqlite3_helper&& rhs) :
+        db_(rhs.db_),
+        current_return_code_(rhs.current_return_code_),
+        transaction_depth_(rhs.transaction_depth_),
+        statement_cache_(std::move(rhs.statement_cache_)),
+        busy_state_(std::move(rhs.busy_state_))
+    {
+        rhs.db_ = nullptr;
+        rhs.current_return_code_ = SQLITE_OK;
+        rhs.transaction_depth_ = 0;
+    }
+
+    /// @brief Assignment operator closes own database handle
+    /// and leaves rhs-object in empty state without closing its handle
+    sqlite3_helper& operator=(sqlite3_helper&& rhs)
+    {
+        if (this != &rhs) {
+            close();
+            db_ = rhs.db_;
+            current_return_code_ = rhs.current_return_code_;
+            transaction_depth_ = rhs.transaction_depth_;
+            statement_cache_ = std::move(rhs.statement_cache_);
+            busy_state_ = std::move(rhs.busy_state_);
+            rhs.db_ = nullptr;
+            rhs.current_return_code_ = SQLITE_OK;
+            rhs.transaction_depth_ = 0;
+        }
+        return *this;
+    }
+
+
+    /// @brief Open or create sqlite3 database
+    /// @return: SQLite error code
+    /// See https://www.sqlite.org/rescode.html for details
+    int open(const char* database_name)
+    {
+        current_return_code_ = sqlite3_open(database_name, &db_);
+        return current_return_code_;
+    }
+
+    /// @brief Open sqlite3 database with SQLITE_OPEN_* flags and optional VFS name
+    /// @return: SQLite error code
+    int open(const char* database_name, int flags, const char* vfs = nullptr)
+    {
+        current_return_code_ = sqlite3_open_v2(database_name, &db_, flags, vfs);
+        return current_return_code_;
+    }
+
+    /// @brief Open sqlite3 database and apply connection settings
+    /// Settings are applied right after open, if any of them fails or journal mode does not take effect
+    /// the database is closed, so that a partially configured connection is never used
+    /// @return: SQLite error code
+    int open(const char* database_name, const open_options& options)
+    {
+        if (open(database_name, options.flags, options.vfs) != SQLITE_OK) {
+            sqlite3_close(db_);
+            db_ = nullptr;
+            return current_return_code_;
+        }
+        if (options.busy_timeout) {
+            sqlite3_busy_timeout(db_, *options.busy_timeout);
+        }
+        if (options.lookaside && set_lookaside(*options.lookaside) != SQLITE_OK) {
+            sqlite3_close(db_);
+            db_ = nullptr;
+            return current_return_code_;
+        }
+
+        // page_size goes before journal_mode, it can't be changed in WAL mode
+        if (options.page_size && exec_pragma("page_size", std::to_string(*options.page_size)) != SQLITE_OK) {
+            sqlite3_close(db_);
+            db_ = nullptr;
+            return current_return_code_;
+        }
+        // Journal mode which did not take effect (e.g. WAL for in-memory database) fails the open
+        if (options.journal_mode && set_journal_mode(options.journal_mode) != SQLITE_OK) {
+            sqlite3_close(db_);
+            db_ = nullptr;
+            return current_return_code_;
+        }
+
+        std::string pragmas;
+        if (options.synchronous) {
+            pragmas += std::string("PRAGMA synchronous=") + options.synchronous + ";";
+        }
+        if (options.temp_store) {
+            pragmas += std::string("PRAGMA temp_store=") + options.temp_store + ";";
+        }
+        if (options.cache_size) {
+            pragmas += "PRAGMA cache_size=" + std::to_string(*options.cache_size) + ";";
+        }
+        if (options.mmap_size) {
+            pragmas += "PRAGMA mmap_size=" + std::to_string(*options.mmap_size) + ";";
+        }
+
+        if (!pragmas.empty()) {
+            current_return_code_ = sqlite3_exec(db_, pragmas.c_str(), nullptr, nullptr, nullptr);
+            if (current_return_code_ != SQLITE_OK) {
+                sqlite3_close(db_);
+                db_ = nullptr;
+            }
+        }
+        return current_return_code_;
+    }
+
+    /// @brief Close database handle
+    /// sqlite3_close_v2() is used: if statements borrowed from the cache (or any other unfinalized
+    /// statements and backups) still exist, the connection is released by the helper and closed
+    /// by SQLite when the last of them is finalized, instead of staying open forever
+    /// @return: SQLite error code
+    /// See https://www.sqlite.org/rescode.html for details
+    int close()
+    {
+        if (statement_cache_) {
+            statement_cache_->clear();
+            if (statement_cache_.use_count() > 1) {
+                // Borrowed statements keep the old cache, statements of a connection opened later go to a new one
+                std::shared_ptr<statement_cache> detached = std::make_shared<statement_cache>();
+                detached->set_capacity(statement_cache_->capacity());
+                statement_cache_ = std::move(detached);
+            }
+        }
+        if (busy_state_ && db_ != nullptr) {
+            // Connection may outlive the helper until its statements are finalized, the handler context does not
+            sqlite3_busy_handler(db_, nullptr, nullptr);
+        }
+        current_return_code_ = sqlite3_close_v2(db_);
+        if (current_return_code_ == SQLITE_OK) {
+            db_ = nullptr;
+        }
+        return current_return_code_;
+    }
+
+    /// @brief Execute SQL query
+    /// If the statement cache is enabled, single-statement SQL is taken from the cache
+    /// and stepped directly, callback receives the same arguments as from sqlite3_exec()
+    /// @return: SQLite error code
+    /// See https://www.sqlite.org/rescode.html for details
+    int exec(const char* sql, sqlite3_callback callback = nullptr)
+    {
+        if (!statement_cache_ || statement_cache_->capacity() == 0) {
+            current_return_code_ = sqlite3_exec(db_, sql, callback, nullptr, nullptr);
+            return current_return_code_;
+        }
+
+        statement stmt = prepare_cached(sql);
+        if (stmt.get_last_error() != SQLITE_OK) {
+            current_return_code_ = stmt.get_last_error();
+            return current_return_code_;
+        }
+        if (stmt.handle() == nullptr) {
+            // Several statements in one string, let SQLite execute them one by one
+            current_return_code_ = sqlite3_exec(db_, sql, callback, nullptr, nullptr);
+            return current_return_code_;
+        }
+
+        std::vector<char*> column_values;
+        std::vector<char*> column_names;
+        int step_code = SQLITE_OK;
+        while ((step_code = sqlite3_step(stmt.handle())) == SQLITE_ROW) {
+            if (callback == nullptr) {
+                continue;
+            }
+            const int column_count = sqlite3_column_count(stmt.handle());
+            if (column_names.empty()) {
+                column_values.resize(static_cast<size_t>(column_count));
+                column_names.resize(static_cast<size_t>(column_count));
+                for (int i = 0; i < column_count; ++i) {
+                    column_names[static_cast<size_t>(i)] = const_cast<char*>(sqlite3_column_name(stmt.handle(), i));
+                }
+            }
+            for (int i = 0; i < column_count; ++i) {
+                column_values[static_cast<size_t>(i)] =
+                    reinterpret_cast<char*>(const_cast<unsigned char*>(sqlite3_column_text(stmt.handle(), i)));
+            }
+            if (callback(nullptr, column_count, column_values.data(), column_names.data()) != 0) {
+                step_code = SQLITE_ABORT;
+                break;
+            }
+        }
+        current_return_code_ = (step_code == SQLITE_DONE) ? SQLITE_OK : step_code;
+        return current_return_code_;
+    }
+
+    /// @brief Compile SQL statement to be executed many times
+    /// @param prepare_flags: SQLITE_PREPARE_* flags, see sqlite3_prepare_v3()
+    /// Check statement::get_last_error() for the compilation result
+    statement prepare(const char* sql, unsigned int prepare_flags = 0) const
+    {
+        return statement(*this, sql, prepare_flags);
+    }
+
+    /// @brief Begin transaction, or savepoint if a transaction is already active
+    /// Check transaction::get_last_error() for the result
+    transaction begin_transaction(transaction_mode mode = transaction_mode::deferred)
+    {
+        return transaction(*this, mode);
+    }
+
+    /// @brief Execute single SQL statement and iterate rows without text conversion
+    /// Statement is taken from the connection cache if it is enabled, parameters are bound in order
+    /// @return: range of rows, empty if compilation or binding failed (see get_last_error())
+    template <typename... Args>
+    query_result query(const char* sql, const Args&... args)
+    {
+        statement stmt = prepare_cached(sql);
+        if (stmt.get_last_error() == SQLITE_OK && stmt.handle() != nullptr) {
+            stmt.bind_all(args...);
+        }
+        current_return_code_ = stmt.get_last_error();
+        if (current_return_code_ != SQLITE_OK) {
+            stmt.finalize();
+        }
+        return query_result(this, std::move(stmt));
+    }
+
+    /// @brief Execute single SQL statement and append all rows to the vector
+    /// Row type T is a tuple, an aggregate or any type having sqlite3_row_traits specialization.
+    /// Result column count is checked once against the row type, not for every row.
+    /// Reserve the vector in advance to avoid reallocation
+    /// @return: SQLite error code, SQLITE_MISMATCH if column count differs from the row type
+    template <typename T, typename... Args>
+    int query_as(std::vector<T>& rows, const char* sql, const Args&... args)
+    {
+        query_result result = query(sql, args...);
+        if (current_return_code_ != SQLITE_OK) {
+            return current_return_code_;
+        }
+        sqlite3_stmt* stmt = result.get_statement().handle();
+        if (stmt == nullptr) {
+            return current_return_code_;
+        }
+        if (sqlite3_column_count(stmt) != sqlite3_row_traits<T>::column_count) {
+            current_return_code_ = SQLITE_MISMATCH;
+            return current_return_code_;
+        }
+        for (auto it = result.begin(); it != result.end(); ++it) {
+            rows.push_back(sqlite3_row_traits<T>::get(stmt));
+        }
+        return current_return_code_;
+    }
+
+    /// @brief Execute single SQL statement and return all rows
+    /// auto files = db.query_as<std::tuple<std::string, double>>("SELECT filename, entropy FROM files");
+    /// Check get_last_error() for the result
+    template <typename T, typename... Args>
+    std::vector<T> query_as(const char* sql, const Args&... args)
+    {
+        std::vector<T> rows;
+        query_as(rows, sql, args...);
+        return rows;
+    }
+
+    /// @brief Take compiled statement from the connection cache, or compile and cache a new one
+    /// Statement is returned to the cache on destruction or finalize(), so the same SQL text
+    /// does not need to be parsed again. Cached statements are compiled with SQLITE_PREPARE_PERSISTENT.
+    /// If the cache is disabled, it is equivalent to prepare().
+    /// SQL containing several statements is not cached, empty statement object is returned
+    /// with SQLITE_OK error code, use exec() for such SQL. The cache remembers such SQL text
+    /// and returns the empty statement without compiling it again.
+    /// Borrowed statements may outlive the helper: the connection is closed when the last one is finalized
+    statement prepare_cached(const char* sql)
+    {
+        if (!statement_cache_ || statement_cache_->capacity() == 0) {
+            return prepare(sql);
+        }
+        statement_cache_entry* entry = nullptr;
+        sqlite3_stmt* stmt = nullptr;
+        const int return_code = statement_cache_->acquire(db_, sql, entry, stmt);
+        if (return_code != SQLITE_OK) {
+            statement failed;
+            failed.current_return_code_ = return_code;
+            return failed;
+        }
+        if (entry == nullptr) {
+            // Statement could not be cached, but it is still usable
+            return statement(db_, nullptr, nullptr, stmt, busy_state_);
+        }
+        return statement(db_, statement_cache_, entry, stmt, busy_state_);
+    }
+
+    /// @brief Set maximum number of statements kept in the connection cache
+    /// Zero capacity (default) disables the cache, least recently used statements
+    /// exceeding the new capacity are finalized
+    void set_statement_cache_capacity(size_t capacity)
+    {
+        if (!statement_cache_) {
+            statement_cache_ = std::make_shared<statement_cache>();
+        }
+        statement_cache_->set_capacity(capacity);
+    }
+
+    /// @brief Finalize all statements in the connection cache which are not in use right now
+    void clear_statement_cache()
+    {
+        if (statement_cache_) {
+            statement_cache_->clear();
+        }
+    }
+
+    /// @brief Return hit/miss counters and size of the connection cache
+    statement_cache_stats get_statement_cache_stats() const
+    {
+        return statement_cache_ ? statement_cache_->stats() : statement_cache_stats();
+    }
+
+    /// @brief Enable memory-mapped I/O for all attached databases, 0 disables it
+    /// Pages are read directly from the mapping, without read() syscall and copy into the page cache.
+    /// Limit is silently capped by SQLITE_MAX_MMAP_SIZE compile-time option
+    /// @return: SQLite error code
+    int set_mmap_size(sqlite3_int64 bytes)
+    {
+        return exec_pragma("mmap_size", std::to_string(bytes));
+    }
+
+    /// @brief Return effective mmap_size limit of the main database, in bytes
+    sqlite3_int64 get_mmap_size()
+    {
+        return query_pragma("mmap_size");
+    }
+
+    /// @brief Return memory-mapped I/O state of the database file
+    /// @param schema: "main", "temp" or attached database name
+    mmap_status get_mmap_status(const char* schema = "main")
+    {
+        mmap_status status;
+        sqlite3_int64 limit = -1;
+        current_return_code_ = sqlite3_file_control(db_, schema, SQLITE_FCNTL_MMAP_SIZE, &limit);
+        if (current_return_code_ != SQLITE_OK) {
+            return status;
+        }
+        status.limit = limit;
+
+        sqlite3_file* file = nullptr;
+        current_return_code_ = sqlite3_file_control(db_, schema, SQLITE_FCNTL_FILE_POINTER, &file);
+        if (current_return_code_ == SQLITE_OK && file != nullptr && file->pMethods != nullptr) {
+            current_return_code_ = file->pMethods->xFileSize(file, &status.file_size);
+        }
+        status.mapped = std::min(status.limit, status.file_size);
+        return status;
+    }
+
+    /// @brief Replace lookaside memory of the connection, SQLite allocates the slots
+    /// Lookaside can't be changed while any of its slots are in use, e.g. by cached or unfinalized
+    /// statements; call clear_statement_cache() and finalize own statements first
+    /// @return: SQLite error code, SQLITE_BUSY if lookaside is in use
+    int set_lookaside(const lookaside_config& config)
+    {
+        current_return_code_ = set_lookaside(db_, config);
+        return current_return_code_;
+    }
+
+    /// @brief Replace lookaside memory without touching the helper's error state, e.g. by a pool between leases
+    /// @return: SQLite error code, SQLITE_BUSY if lookaside is in use
+    static int set_lookaside(sqlite3* db, const lookaside_config& config)
+    {
+        if (db == nullptr) {
+            return SQLITE_MISUSE;
+        }
+        return sqlite3_db_config(db, SQLITE_DBCONFIG_LOOKASIDE, nullptr, config.slot_size, config.slot_count);
+    }
+
+    /// @brief Snapshot of connection and process-wide memory and cache counters
+    /// Use to size cache_size and lookaside from cache hit/miss/spill and lookaside miss counters
+    /// @param reset: reset cache and lookaside counters and high-water marks of this connection after reading;
+    /// process-wide counters are shared by all connections and reset only by reset_process_stats()
+    statistics stats(bool reset = false)
+    {
+        statistics result;
+        current_return_code_ = read_stats(db_, result, reset);
+        return result;
+    }
+
+    /// @brief Read counters without touching the helper's error state, e.g. from a sampling thread
+    /// Thread-safe if the connection is opened in serialized mode (default, or SQLITE_OPEN_FULLMUTEX)
+    /// @param reset: reset connection counters after reading, see stats()
+    /// @return: SQLite error code
+    static int read_stats(sqlite3* db, statistics& result, bool reset = false)
+    {
+        if (db == nullptr) {
+            return SQLITE_MISUSE;
+        }
+        const int reset_flag = reset ? 1 : 0;
+        int current = 0;
+        int highwater = 0;
+        int return_code = SQLITE_OK;
+        const auto connection_value = [&](int op, sqlite3_int64* value, sqlite3_int64* highwater_value) {
+            if (return_code == SQLITE_OK) {
+                return_code = sqlite3_db_status(db, op, &current, &highwater, reset_flag);
+                if (value != nullptr) {
+                    *value = current;
+                }
+                if (highwater_value != nullptr) {
+                    *highwater_value = highwater;
+                }
+            }
+        };
+        connection_value(SQLITE_DBSTATUS_CACHE_HIT, &result.cache_hit, nullptr);
+        connection_value(SQLITE_DBSTATUS_CACHE_MISS, &result.cache_miss, nullptr);
+        connection_value(SQLITE_DBSTATUS_CACHE_WRITE, &result.cache_write, nullptr);
+        connection_value(SQLITE_DBSTATUS_CACHE_SPILL, &result.cache_spill, nullptr);
+        connection_value(SQLITE_DBSTATUS_CACHE_USED, &result.cache_used, nullptr);
+        connection_value(SQLITE_DBSTATUS_CACHE_USED_SHARED, &result.cache_used_shared, nullptr);
+        connection_value(SQLITE_DBSTATUS_LOOKASIDE_USED, &result.lookaside_used.current, &result.lookaside_used.highwater);
+        // Lookaside hit and miss counts are reported as the high-water value
+        connection_value(SQLITE_DBSTATUS_LOOKASIDE_HIT, nullptr, &result.lookaside_hit);
+        connection_value(SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, nullptr, &result.lookaside_miss_size);
+        connection_value(SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL, nullptr, &result.lookaside_miss_full);
+        connection_value(SQLITE_DBSTATUS_SCHEMA_USED, &result.schema_used, nullptr);
+        connection_value(SQLITE_DBSTATUS_STMT_USED, &result.statement_used, nullptr);
+
+        sqlite3_int64 unused = 0;
+        const auto process_value = [&](int op, sqlite3_int64& value, sqlite3_int64& highwater_value) {
+            if (return_code == SQLITE_OK) {
+                return_code = sqlite3_status64(op, &value, &highwater_value, 0);
+            }
+        };
+        process_value(SQLITE_STATUS_MEMORY_USED, result.memory_used.current, result.memory_used.highwater);
+        process_value(SQLITE_STATUS_MALLOC_COUNT, result.malloc_count.current, result.malloc_count.highwater);
+        process_value(SQLITE_STATUS_MALLOC_SIZE, unused, result.malloc_size_highwater);
+        process_value(SQLITE_STATUS_PAGECACHE_USED, result.pagecache_used.current, result.pagecache_used.highwater);
+        process_value(SQLITE_STATUS_PAGECACHE_OVERFLOW, result.pagecache_overflow.current, result.pagecache_overflow.highwater);
+        process_value(SQLITE_STATUS_PAGECACHE_SIZE, unused, result.pagecache_size_highwater);
+        return return_code;
+    }
+
+    /// @brief Reset high-water marks of process-wide memory and page cache counters (sqlite3_status64())
+    /// They are shared by every connection of the process, so only the owner of the whole process
+    /// statistics, not a per-connection sampler, should reset them
+    /// @return: SQLite error code
+    static int reset_process_stats()
+    {
+        sqlite3_int64 current = 0;
+        sqlite3_int64 highwater = 0;
+        int return_code = SQLITE_OK;
+        for (const int op : { SQLITE_STATUS_MEMORY_USED, SQLITE_STATUS_MALLOC_COUNT, SQLITE_STATUS_MALLOC_SIZE,
+            SQLITE_STATUS_PAGECACHE_USED, SQLITE_STATUS_PAGECACHE_OVERFLOW, SQLITE_STATUS_PAGECACHE_SIZE }) {
+            if (return_code == SQLITE_OK) {
+                return_code = sqlite3_status64(op, &current, &highwater, 1);
+            }
+        }
+        return return_code;
+    }
+
+    /// @brief Copy the database into another connection while it is in use (sqlite3_backup_*)
+    /// Pages are copied in steps, so the backup never holds the source locked for long.
+    /// If another connection modifies the source, the backup starts over; changes made through
+    /// this connection are applied to the destination as they happen.
+    /// Destination content is replaced, it must not be used by other connections until the backup is done
+    /// @return: SQLite error code, SQLITE_ABORT if aborted by progress callback,
+    /// SQLITE_MISUSE if either connection is not opened
+    int backup_to(sqlite3_helper& destination, const backup_options& options)
+    {
+        current_return_code_ = run_backup(destination.db_, options);
+        return current_return_code_;
+    }
+
+    /// @brief Copy the database into another connection with default settings
+    int backup_to(sqlite3_helper& destination)
+    {
+        return backup_to(destination, backup_options());
+    }
+
+    /// @brief Copy the database into a file, created if it does not exist and overwritten otherwise
+    /// @return: SQLite error code
+    int backup_to_file(const char* file_name)
+    {
+        return backup_to_file(file_name, backup_options());
+    }
+
+    /// @brief Copy the database into a file with backup settings
+    /// @return: SQLite error code
+    int backup_to_file(const char* file_name, const backup_options& options)
+    {
+        sqlite3_helper destination;
+        if (destination.open(file_name) != SQLITE_OK) {
+            current_return_code_ = destination.get_last_error();
+            return current_return_code_;
+        }
+        return backup_to(destination, options);
+    }
+
+    /// @brief Replace the file with the data: it is written into "<file_name>.tmp", flushed to disk and renamed
+    /// over the file, so readers and a crash leave either the old or the new content.
+    /// On Windows rename() does not replace an existing file, so it is removed first and there is a moment
+    /// without the file: the replacement is not atomic there
+    /// @return: SQLite error code, SQLITE_CANTOPEN if the temporary file can't be created
+    static int write_file(const char* file_name, const void* data, size_t size)
+    {
+        const std::string temporary = std::string(file_name) + ".tmp";
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (file == nullptr) {
+            return SQLITE_CANTOPEN;
+        }
+        bool written = std::fwrite(data, 1, size, file) == size && std::fflush(file) == 0;
+#ifdef _WIN32
+        written = written && _commit(_fileno(file)) == 0;
+#else
+        written = written && fsync(fileno(file)) == 0;
+#endif
+        if (std::fclose(file) != 0 || !written) {
+            std::remove(temporary.c_str());
+            return SQLITE_IOERR;
+        }
+#ifdef _WIN32
+        std::remove(file_name);
+#endif
+        if (std::rename(temporary.c_str(), file_name) != 0) {
+            std::remove(temporary.c_str());
+            return SQLITE_IOERR;
+        }
+#ifndef _WIN32
+        // The new directory entry is durable once the directory is synced
+        const char* slash = std::strrchr(file_name, '/');
+        const std::string directory = (slash == nullptr) ? std::string(".")
+            : std::string(file_name, static_cast<size_t>(std::max<std::ptrdiff_t>(slash - file_name, 1)));
+        const int descriptor = ::open(directory.c_str(), O_RDONLY);
+        if (descriptor >= 0) {
+            fsync(descriptor);
+            ::close(descriptor);
+        }
+#endif
+        return SQLITE_OK;
+    }
+
+    /// @brief Copy database content into an image, one allocation and copy of the whole database
+    /// Requires SQLite built with SQLITE_ENABLE_DESERIALIZE before 3.36
+    /// @param schema: "main", "temp" or attached database name
+    /// @return: empty image on error, check get_last_error()
+    image serialize(const char* schema = "main")
+    {
+#ifdef SQLITE3_HELPER_DESERIALIZE
+        sqlite3_int64 size = 0;
+        unsigned char* data = sqlite3_serialize(db_, schema, &size, 0);
+        current_return_code_ = (data != nullptr || size == 0) ? SQLITE_OK : SQLITE_NOMEM;
+        return image(data, (data != nullptr) ? size : 0);
+#else
+        static_cast<void>(schema);
+        current_return_code_ = SQLITE_ERROR;
+        return image();
+#endif
+    }
+
+    /// @brief Replace the schema with an in-memory database taking over the image buffer, without copy
+    /// The database may grow beyond the image, its memory is freed on close.
+    /// Fails with SQLITE_BUSY inside a read transaction
+    /// @param read_only: open the database read-only
+    /// @return: SQLite error code, the image is consumed even on error
+    int deserialize(image&& source, const char* schema = "main", bool read_only = false)
+    {
+#ifdef SQLITE3_HELPER_DESERIALIZE
+        const sqlite3_int64 size = source.size_;
+        unsigned char* data = source.data_;
+        source.data_ = nullptr;
+        source.size_ = 0;
+        const unsigned flags = SQLITE_DESERIALIZE_FREEONCLOSE | SQLITE_DESERIALIZE_RESIZEABLE
+            | (read_only ? SQLITE_DESERIALIZE_READONLY : 0u);
+        current_return_code_ = sqlite3_deserialize(db_, schema, data, size, size, flags);
+#else
+        static_cast<void>(source);
+        static_cast<void>(schema);
+        static_cast<void>(read_only);
+        current_return_code_ = SQLITE_ERROR;
+#endif
+        return current_return_code_;
+    }
+
+    /// @brief Replace the schema with an in-memory copy of serialized database bytes,
+    /// e.g. to clone one prebuilt image into many connections
+    /// @return: SQLite error code
+    int deserialize(const void* data, sqlite3_int64 size, const char* schema = "main", bool read_only = false)
+    {
+        unsigned char* copy = static_cast<unsigned char*>(sqlite3_malloc64(static_cast<sqlite3_uint64>(std::max<sqlite3_int64>(size, 1))));
+        if (copy == nullptr) {
+            current_return_code_ = SQLITE_NOMEM;
+            return current_return_code_;
+        }
+        if (size > 0) {
+            std::memcpy(copy, data, static_cast<size_t>(size));
+        }
+        return deserialize(image(copy, size), schema, read_only);
+    }
+
+    /// @brief Replace the schema with an in-memory copy of the image
+    /// @return: SQLite error code
+    int deserialize(const image& source, const char* schema = "main", bool read_only = false)
+    {
+        return deserialize(source.data(), source.size(), schema, read_only);
+    }
+
+    /// @brief Retry locked operations according to the policy, instead of returning SQLITE_BUSY
+    /// Replaces sqlite3_busy_timeout() or any other busy handler of the connection.
+    /// Shared-cache unlock notification applies to statements prepared after the policy is set.
+    /// Statements outliving the helper are not retried, close() removes the handler
+    /// @return: SQLite error code
+    int set_busy_policy(const busy_policy& policy)
+    {
+        if (!busy_state_) {
+            busy_state_ = std::make_shared<busy_state>();
+        }
+        busy_state_->policy = policy;
+        current_return_code_ = sqlite3_busy_handler(db_, &sqlite3_helper::busy_handler, busy_state_.get());
+        return current_return_code_;
+    }
+
+    /// @brief Return lock contention counters, all zero if busy policy is not set
+    busy_stats get_busy_stats() const
+    {
+        busy_stats stats;
+        if (busy_state_) {
+            stats.busy_events = busy_state_->busy_events.load(std::memory_order_relaxed);
+            stats.retries = busy_state_->retries.load(std::memory_order_relaxed);
+            stats.timeouts = busy_state_->timeouts.load(std::memory_order_relaxed);
+            stats.unlock_waits = busy_state_->unlock_waits.load(std::memory_order_relaxed);
+            stats.total_wait = std::chrono::microseconds(busy_state_->wait_us.load(std::memory_order_relaxed));
+        }
+        return stats;
+    }
+
+    /// @brief Change journal mode of the main database
+    /// @param mode: "DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL" or "OFF"
+    /// @return: SQLite error code, SQLITE_ERROR if the mode was not applied
+    /// (e.g. WAL for in-memory database)
+    int set_journal_mode(const char* mode)
+    {
+        std::string applied;
+        for (auto row : query((std::string("PRAGMA journal_mode=") + mode).c_str())) {
+            applied = std::string(row.get_text(0));
+        }
+        if (current_return_code_ == SQLITE_OK && sqlite3_stricmp(applied.c_str(), mode) != 0) {
+            current_return_code_ = SQLITE_ERROR;
+        }
+        return current_return_code_;
+    }
+
+    /// @brief Return journal mode of the main database in lower case, e.g. "wal", empty on error
+    std::string get_journal_mode()
+    {
+        std::string mode;
+        for (auto row : query("PRAGMA journal_mode")) {
+            mode = std::string(row.get_text(0));
+        }
+        return mode;
+    }
+
+    /// @brief Set page cache size of all attached databases
+    /// @param size: pages if positive, KiB if negative
+    /// @return: SQLite error code
+    int set_cache_size(int size)
+    {
+        return exec_pragma("cache_size", std::to_string(size));
+    }
+
+    /// @brief Return page cache size of the main database, pages if positive, KiB if negative
+    int get_cache_size()
+    {
+        return static_cast<int>(query_pragma("cache_size"));
+    }
+
+    /// @brief Set number of dirty pages in the cache after which SQLite spills
+    /// them to the database file before commit, 0 disables spilling
+    /// so that large transactions are kept in memory until commit
+    /// @return: SQLite error code
+    int set_cache_spill(int pages)
+    {
+        return exec_pragma("cache_spill", std::to_string(pages));
+    }
+
+    /// @brief Return cache spill threshold in pages, 0 if spilling is disabled
+    int get_cache_spill()
+    {
+        return static_cast<int>(query_pragma("cache_spill"));
+    }
+
+    /// @brief Is database in valid state
+    operator bool() const
+    {
+        return is_valid(); 
+    }
+
+    /// @brief Is database in valid state (handle is opened and last status is SQLITE_OK)
+    bool is_valid() const
+    {
+        return (db_ != nullptr) && (current_return_code_ == SQLITE_OK);
+    }
+
+    /// @brief Underlying database handle, owned by the object
+    /// Use it for SQLite API not covered by the helper
+    sqlite3* handle() const
+    {
+        return db_;
+    }
+
+    /// @brief Check if the current sqlite3 build is thread-safe
+    static bool is_threadsafe()
+    {
+        return sqlite3_threadsafe();
+    }
+
+    /// @brief Return last error code of any SQLite operation
+    /// If the code is not SQLITE_OK, helper is not in valid state
+    int get_last_error() const
+    { 
+        return current_return_code_; 
+    }
+
+    /// @brief Return last error message based on error code 
+    const char* get_last_error_message() const
+    {
+        return sqlite3_errstr(current_return_code_);
+    }
+
+private:
+
+    /// @brief Run "PRAGMA name=value"
+    int exec_pragma(const char* name, const std::string& value)
+    {
+        current_return_code_ = sqlite3_exec(db_, (std::string("PRAGMA ") + name + "=" + value).c_str(), nullptr, nullptr, nullptr);
+        return current_return_code_;
+    }
+
+    /// @brief Return integer value of "PRAGMA name", 0 on error
+    sqlite3_int64 query_pragma(const char* name)
+    {
+        sqlite3_int64 value = 0;
+        for (auto row : query((std::string("PRAGMA ") + name).c_str())) {
+            value = row.get_int64(0);
+        }
+        return value;
+    }
+
+    /// @brief Step the backup until done, error, abort or timeout, then finish it
+    int run_backup(sqlite3* destination, const backup_options& options)
+    {
+        // sqlite3_backup_init() does not check the handles
+        if (db_ == nullptr || destination == nullptr) {
+            return SQLITE_MISUSE;
+        }
+        sqlite3_backup* backup = sqlite3_backup_init(destination, options.destination_schema, db_, options.source_schema);
+        if (backup == nullptr) {
+            return sqlite3_errcode(destination);
+        }
+        backup_progress progress;
+        int copied = 0;
+        int return_code = SQLITE_OK;
+        auto last_copied = std::chrono::steady_clock::now();
+        for (;;) {
+            const bool final_step = options.max_restarts >= 0 && progress.restarts >= options.max_restarts;
+            return_code = sqlite3_backup_step(backup, final_step ? -1 : options.pages_per_step);
+            const auto now = std::chrono::steady_clock::now();
+            if (return_code == SQLITE_BUSY || return_code == SQLITE_LOCKED) {
+                if (now - last_copied > options.busy_timeout) {
+                    break;
+                }
+            }
+            else if (return_code != SQLITE_OK && return_code != SQLITE_DONE) {
+                break;
+            }
+
+            progress.page_count = sqlite3_backup_pagecount(backup);
+            progress.remaining = sqlite3_backup_remaining(backup);
+            const int now_copied = progress.page_count - progress.remaining;
+            if (return_code != SQLITE_BUSY && return_code != SQLITE_LOCKED) {
+                // A step copies pages from the beginning again after the source was modified
+                if (now_copied <= copied && return_code == SQLITE_OK) {
+                    ++progress.restarts;
+                }
+                last_copied = now;
+            }
+            copied = now_copied;
+            if (options.progress && !options.progress(progress) && return_code != SQLITE_DONE) {
+                return_code = SQLITE_ABORT;
+                break;
+            }
+            if (return_code == SQLITE_DONE) {
+                break;
+            }
+
+            if (options.step_delay.count() > 0) {
+                std::this_thread::sleep_for(options.step_delay);
+            }
+            else if (return_code == SQLITE_OK) {
+                std::this_thread::yield();
+            }
+            else {
+                // Do not spin while the lock is held by another connection
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        // Finishing an incomplete backup rolls back the destination
+        const int finish_code = sqlite3_backup_finish(backup);
+        return (return_code == SQLITE_DONE) ? finish_code : return_code;
+    }
+
+    /// @brief Busy policy and contention counters, sqlite3_busy_handler() context
+    /// Shared with statements, which may outlive the helper
+    struct busy_state
+    {
+        busy_policy policy;
+
+        std::atomic<size_t> busy_events{ 0 };
+        std::atomic<size_t> retries{ 0 };
+        std::atomic<size_t> timeouts{ 0 };
+        std::atomic<size_t> unlock_waits{ 0 };
+        std::atomic<sqlite3_int64> wait_us{ 0 };
+
+        /// Start of the current busy event, handler is called by one thread at a time
+        std::chrono::steady_clock::time_point busy_started;
+
+        /// Jitter source
+        std::minstd_rand random{ std::random_device()() };
+
+        /// @brief Block in sqlite3_unlock_notify() until the blocking connection finishes its transaction
+        /// @return: SQLITE_OK if unlocked, SQLITE_LOCKED if waiting would deadlock
+        int wait_for_unlock(sqlite3* db)
+        {
+            struct notification
+            {
+                bool fired = false;
+                std::mutex mutex;
+                std::condition_variable condition;
+            } unlocked;
+
+#ifdef SQLITE_ENABLE_UNLOCK_NOTIFY
+            const auto started = std::chrono::steady_clock::now();
+            const int return_code = sqlite3_unlock_notify(db, [](void** arguments, int count) {
+                for (int i = 0; i < count; ++i) {
+                    notification* waiter = static_cast<notification*>(arguments[i]);
+                    std::lock_guard<std::mutex> lock(waiter->mutex);
+                    waiter->fired = true;
+                    waiter->condition.notify_one();
+                }
+            }, &unlocked);
+            if (return_code != SQLITE_OK) {
+                return return_code;
+            }
+            std::unique_lock<std::mutex> lock(unlocked.mutex);
+            unlocked.condition.wait(lock, [&unlocked] { return unlocked.fired; });
+            unlock_waits.fetch_add(1, std::memory_order_relaxed);
+            wait_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - started).count(), std::memory_order_relaxed);
+            return SQLITE_OK;
+#else
+            static_cast<void>(db);
+            static_cast<void>(unlocked);
+            return SQLITE_LOCKED;
+#endif
+        }
+    };
+
+    /// @brief sqlite3_busy_handler() callback: exponential backoff with jitter until the deadline
+    /// @param count: number of times the handler was invoked for the same lock event
+    /// @return: non-zero to retry, zero to return SQLITE_BUSY
+    static int busy_handler(void* context, int count)
+    {
+        busy_state* state = static_cast<busy_state*>(context);
+        const auto now = std::chrono::steady_clock::now();
+        if (count == 0) {
+            state->busy_events.fetch_add(1, std::memory_order_relaxed);
+            state->busy_started = now;
+        }
+
+        double delay = static_cast<double>(state->policy.initial_delay.count()) *
+            std::pow(state->policy.multiplier, static_cast<double>(std::min(count, 64)));
+        delay = std::min(delay, static_cast<double>(state->policy.max_delay.count()));
+        // Full jitter between half and the whole delay, to spread competing connections apart
+        std::uniform_real_distribution<double> jitter(0.5, 1.0);
+        const auto sleep = std::chrono::microseconds(static_cast<sqlite3_int64>(delay * jitter(state->random)));
+
+        if (now + sleep - state->busy_started > state->policy.timeout) {
+            state->timeouts.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        std::this_thread::sleep_for(sleep);
+        state->retries.fetch_add(1, std::memory_order_relaxed);
+        state->wait_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - now).count(), std::memory_order_relaxed);
+        return 1;
+    }
+
+    /// @brief Cached statement and the SQL text it was compiled from
+    struct statement_cache_entry
+    {
+        /// Cache index keys are views of this text, it is not modified after insertion
+        std::string sql;
+
+        /// nullptr for SQL which is not cached, see statement_cache_stats::bypassed
+        sqlite3_stmt* stmt = nullptr;
+
+        /// Borrowed by a statement object, could not be shared or evicted
+        bool in_use = false;
+    };
+
+    /// @brief LRU cache of compiled statements keyed by SQL text
+    /// Allocated on demand and shared with borrowed statements, so they survive helper moves and destruction
+    class statement_cache
+    {
+    public:
+
+        statement_cache() = default;
+
+        ~statement_cache()
+        {
+            clear();
+        }
+
+        statement_cache(const statement_cache&) = delete;
+        statement_cache& operator=(const statement_cache&) = delete;
+
+        size_t capacity() const
+        {
+            return stats_.capacity;
+        }
+
+        void set_capacity(size_t capacity)
+        {
+            stats_.capacity = capacity;
+            evict();
+        }
+
+        statement_cache_stats stats() const
+        {
+            statement_cache_stats current = stats_;
+            current.size = entries_.size();
+            return current;
+        }
+
+        /// @brief Find unused statement for the SQL text, or compile a new one
+        /// @param entry: cache slot, nullptr if the statement is not cached and owned by the caller
+        /// @return: SQLite error code of the compilation
+        int acquire(sqlite3* db, const char* sql, statement_cache_entry*& entry, sqlite3_stmt*& stmt)
+        {
+            entry = nullptr;
+            stmt = nullptr;
+            // Lookup by view, the hit path does not allocate
+            auto found = index_.find(std::string_view(sql));
+            if (found != index_.end() && found->second->stmt == nullptr) {
+                ++stats_.bypassed;
+                entries_.splice(entries_.begin(), entries_, found->second);
+                return SQLITE_OK;
+            }
+            if (found != index_.end() && !found->second->in_use) {
+                ++stats_.hits;
+                entries_.splice(entries_.begin(), entries_, found->second);
+                entry = &*found->second;
+                entry->in_use = true;
+                stmt = entry->stmt;
+                return SQLITE_OK;
+            }
+
+            const char* tail = nullptr;
+            const int return_code = sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, &tail);
+            if (return_code != SQLITE_OK) {
+                ++stats_.misses;
+                return return_code;
+            }
+            if (stmt == nullptr || !is_blank(tail)) {
+                // Empty SQL or several statements: remember the text, so that it is not compiled again
+                sqlite3_finalize(stmt);
+                stmt = nullptr;
+                ++stats_.bypassed;
+                insert(sql, nullptr);
+                evict();
+                return SQLITE_OK;
+            }
+            ++stats_.misses;
+            if (found != index_.end()) {
+                // The cached copy is busy: caller owns the statement
+                return SQLITE_OK;
+            }
+
+            entry = &insert(sql, stmt);
+            entry->in_use = true;
+            evict();
+            return SQLITE_OK;
+        }
+
+        /// @brief Return borrowed statement, it becomes available for the next acquire()
+        void release(statement_cache_entry* entry)
+        {
+            sqlite3_reset(entry->stmt);
+            sqlite3_clear_bindings(entry->stmt);
+            entry->in_use = false;
+            evict();
+        }
+
+        /// @brief Finalize all statements not in use
+        void clear()
+        {
+            for (auto it = entries_.begin(); it != entries_.end();) {
+                if (it->in_use) {
+                    ++it;
+                    continue;
+                }
+                sqlite3_finalize(it->stmt);
+                index_.erase(std::string_view(it->sql));
+                it = entries_.erase(it);
+            }
+        }
+
+    private:
+
+        /// Add the most recently used entry and index it by its own copy of the text
+        statement_cache_entry& insert(const char* sql, sqlite3_stmt* stmt)
+        {
+            entries_.push_front(statement_cache_entry());
+            statement_cache_entry& entry = entries_.front();
+            entry.sql = sql;
+            entry.stmt = stmt;
+            index_.emplace(std::string_view(entry.sql), entries_.begin());
+            return entry;
+        }
+
+        /// Finalize least recently used statements not in use, until the cache fits its capacity
+        void evict()
+        {
+            auto it = entries_.end();
+            while (entries_.size() > stats_.capacity && it != entries_.begin()) {
+                --it;
+                if (it->in_use) {
+                    continue;
+                }
+                sqlite3_finalize(it->stmt);
+                index_.erase(std::string_view(it->sql));
+                it = entries_.erase(it);
+                ++stats_.evictions;
+            }
+        }
+
+        static bool is_blank(const char* tail)
+        {
+            while (tail != nullptr && *tail != '\0') {
+                if (*tail != ' ' && *tail != '\t' && *tail != '\n' && *tail != '\r' && *tail != ';') {
+                    return false;
+                }
+                ++tail;
+            }
+            return true;
+        }
+
+        /// Most recently used statements first
+        std::list<statement_cache_entry> entries_;
+
+        /// SQL text to cache slot, keys point into statement_cache_entry::sql
+        std::unordered_map<std::string_view, std::list<statement_cache_entry>::iterator> index_;
+
+        /// Counters and capacity
+        statement_cache_stats stats_;
+    };
+
+    /// SQLite3 Handle
+    sqlite3* db_ = nullptr;
+
+    /// Last returned error code
+    int current_return_code_ = SQLITE_OK;
+
+    /// Number of active transaction guards, nested ones are savepoints
+    int transaction_depth_ = 0;
+
+    /// Compiled statements cache, nullptr until capacity is set
+    std::shared_ptr<statement_cache> statement_cache_;
+
+    /// Busy policy and counters, nullptr until the policy is set
+    std::shared_ptr<busy_state> busy_state_;
+};
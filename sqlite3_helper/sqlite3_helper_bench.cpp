@@ -0,0 +1,336 @@
+#include "sqlite3_helper.h"
+#include "sqlite3_allocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+/// @brief Record inserted and queried by all workloads
+struct FileRecord
+{
+    std::string filename;
+    double entropy;
+};
+
+/// @brief Minimal microbenchmark harness: times every operation
+/// and reports throughput with latency percentiles
+class bench_harness
+{
+public:
+
+    /// @brief Run op(i) for i in [0, operations), timing each call
+    /// @param rows_per_operation: rows processed by one call, for throughput in rows/s
+    template <typename Operation>
+    void run(const std::string& name, size_t operations, Operation op, size_t rows_per_operation = 1)
+    {
+        std::vector<double> latencies;
+        latencies.reserve(operations);
+
+        const auto started = clock::now();
+        for (size_t i = 0; i < operations; ++i) {
+            const auto op_started = clock::now();
+            op(i);
+            latencies.push_back(std::chrono::duration<double, std::micro>(clock::now() - op_started).count());
+        }
+        const double seconds = std::chrono::duration<double>(clock::now() - started).count();
+        report(name, operations * rows_per_operation, seconds, latencies);
+    }
+
+    /// @brief Print table header
+    static void header()
+    {
+        std::cout << std::left << std::setw(48) << "workload" << std::right
+            << std::setw(14) << "rows/s"
+            << std::setw(12) << "p50 us"
+            << std::setw(12) << "p99 us"
+            << std::setw(12) << "p999 us" << '\n';
+    }
+
+private:
+
+    using clock = std::chrono::steady_clock;
+
+    static double percentile(const std::vector<double>& sorted, double fraction)
+    {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        const size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1));
+        return sorted[index];
+    }
+
+    static void report(const std::string& name, size_t rows, double seconds, std::vector<double>& latencies)
+    {
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << std::left << std::setw(48) << name << std::right << std::fixed
+            << std::setw(14) << std::setprecision(0) << (seconds > 0.0 ? static_cast<double>(rows) / seconds : 0.0)
+            << std::setw(12) << std::setprecision(2) << percentile(latencies, 0.5)
+            << std::setw(12) << std::setprecision(2) << percentile(latencies, 0.99)
+            << std::setw(12) << std::setprecision(2) << percentile(latencies, 0.999) << '\n';
+    }
+};
+
+/// Database file used by all workloads
+const char* const bench_database = "sqlite3_helper_bench.db";
+
+/// Just display the error code and message if the last operation failed
+void check_errors(const sqlite3_helper& db)
+{
+    if (db.get_last_error() != SQLITE_OK) {
+        std::cout << "Error executing SQL, code = " << db.get_last_error()
+            << "; description: " << db.get_last_error_message() << '\n';
+    }
+}
+
+/// Create empty database file with the files table
+void create_database(sqlite3_helper& db, const char* journal_mode)
+{
+    db.close();
+    std::remove(bench_database);
+    std::remove((std::string(bench_database) + "-wal").c_str());
+    std::remove((std::string(bench_database) + "-shm").c_str());
+
+    sqlite3_helper::open_options options;
+    options.journal_mode = journal_mode;
+    options.synchronous = "NORMAL";
+    db.open(bench_database, options);
+    check_errors(db);
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY, filename TEXT, entropy REAL)");
+    check_errors(db);
+}
+
+FileRecord make_record(size_t i)
+{
+    return FileRecord{ "C:/Temp/file_" + std::to_string(i) + ".txt", static_cast<double>(i % 800) / 100.0 };
+}
+
+/// Fill table with rows using the fastest path, for read workloads
+void populate(sqlite3_helper& db, size_t rows)
+{
+    sqlite3_helper::bulk_inserter<FileRecord> inserter(db, "files", { "filename", "entropy" });
+    for (size_t i = 0; i < rows; ++i) {
+        inserter.add(make_record(i));
+    }
+}
+
+void insert_workloads(bench_harness& harness, size_t rows, size_t autocommit_rows)
+{
+    sqlite3_helper db;
+
+    create_database(db, "DELETE");
+    harness.run("insert: exec() per row, autocommit", autocommit_rows, [&](size_t i) {
+        const FileRecord record = make_record(i);
+        const std::string sql = "INSERT INTO files(filename, entropy) VALUES ('"
+            + record.filename + "', " + std::to_string(record.entropy) + ")";
+        db.exec(sql.c_str());
+    });
+
+    create_database(db, "DELETE");
+    {
+        sqlite3_helper::transaction transaction(db);
+        harness.run("insert: exec() per row, one transaction", rows, [&](size_t i) {
+            const FileRecord record = make_record(i);
+            const std::string sql = "INSERT INTO files(filename, entropy) VALUES ('"
+                + record.filename + "', " + std::to_string(record.entropy) + ")";
+            db.exec(sql.c_str());
+        });
+        transaction.commit();
+    }
+
+    create_database(db, "DELETE");
+    {
+        sqlite3_helper::transaction transaction(db);
+        sqlite3_helper::statement insert = db.prepare("INSERT INTO files(filename, entropy) VALUES (?, ?)");
+        harness.run("insert: prepared statement, one transaction", rows, [&](size_t i) {
+            const FileRecord record = make_record(i);
+            insert.exec(record.filename, record.entropy);
+        });
+        insert.finalize();
+        transaction.commit();
+    }
+
+    create_database(db, "DELETE");
+    {
+        sqlite3_helper::bulk_inserter<FileRecord> inserter(db, "files", { "filename", "entropy" });
+        harness.run("insert: bulk_inserter", rows, [&](size_t i) {
+            inserter.add(make_record(i));
+        });
+        inserter.flush();
+    }
+}
+
+void journal_workloads(bench_harness& harness, size_t autocommit_rows)
+{
+    sqlite3_helper db;
+    for (const char* journal_mode : { "DELETE", "WAL" }) {
+        create_database(db, journal_mode);
+        sqlite3_helper::statement insert = db.prepare("INSERT INTO files(filename, entropy) VALUES (?, ?)");
+        harness.run(std::string("insert: prepared, autocommit, ") + journal_mode, autocommit_rows, [&](size_t i) {
+            const FileRecord record = make_record(i);
+            insert.exec(record.filename, record.entropy);
+        });
+    }
+}
+
+/// Callback for exec() workloads, accumulates entropy to keep the work observable
+double callback_sum = 0.0;
+
+int sum_callback(void*, int, char** column_values, char**)
+{
+    callback_sum += column_values[1] ? std::atof(column_values[1]) : 0.0;
+    return 0;
+}
+
+void read_workloads(bench_harness& harness, size_t rows, size_t lookups)
+{
+    const size_t scans = 10;
+    sqlite3_helper db;
+    create_database(db, "WAL");
+    populate(db, rows);
+
+    harness.run("lookup: exec() with formatted SQL", lookups, [&](size_t i) {
+        const std::string sql = "SELECT filename, entropy FROM files WHERE id = " + std::to_string(i % rows + 1);
+        db.exec(sql.c_str(), &sum_callback);
+    });
+
+    sqlite3_helper::statement select = db.prepare("SELECT filename, entropy FROM files WHERE id = ?");
+    double sum = 0.0;
+    harness.run("lookup: prepared statement", lookups, [&](size_t i) {
+        select.reset();
+        select.bind(1, static_cast<sqlite3_int64>(i % rows + 1));
+        if (select.step() == SQLITE_ROW) {
+            sum += select.column<double>(1);
+        }
+    });
+    select.finalize();
+
+    db.set_statement_cache_capacity(16);
+    harness.run("lookup: query() with statement cache", lookups, [&](size_t i) {
+        for (auto row : db.query("SELECT filename, entropy FROM files WHERE id = ?", static_cast<sqlite3_int64>(i % rows + 1))) {
+            sum += row.get_double(1);
+        }
+    });
+
+    harness.run("scan: exec() with callback", scans, [&](size_t) {
+        db.exec("SELECT filename, entropy FROM files", &sum_callback);
+    }, rows);
+
+    harness.run("scan: query() typed iteration", scans, [&](size_t) {
+        for (auto row : db.query("SELECT filename, entropy FROM files")) {
+            sum += static_cast<double>(row.get_text(0).size()) + row.get_double(1);
+        }
+    }, rows);
+
+    harness.run("scan: query_as<FileRecord>()", scans, [&](size_t) {
+        std::vector<FileRecord> records;
+        records.reserve(rows);
+        db.query_as(records, "SELECT filename, entropy FROM files");
+        sum += static_cast<double>(records.size());
+    }, rows);
+
+    harness.run("range: query() 100 rows by id", lookups / 10, [&](size_t i) {
+        const sqlite3_int64 first = static_cast<sqlite3_int64>(i * 100 % rows);
+        for (auto row : db.query("SELECT filename, entropy FROM files WHERE id > ? AND id <= ?", first, first + 100)) {
+            sum += row.get_double(1);
+        }
+    }, 100);
+
+    {
+        sqlite3_helper::transaction transaction(db);
+        sqlite3_helper::statement update = db.prepare("UPDATE files SET entropy = ? WHERE id = ?");
+        harness.run("update: prepared statement, one transaction", lookups, [&](size_t i) {
+            update.exec(static_cast<double>(i % 800) / 100.0, static_cast<sqlite3_int64>(i % rows + 1));
+        });
+        update.finalize();
+        transaction.commit();
+    }
+
+    harness.run("update: exec(), autocommit", lookups / 100, [&](size_t i) {
+        const std::string sql = "UPDATE files SET entropy = 1.5 WHERE id = " + std::to_string(i % rows + 1);
+        db.exec(sql.c_str());
+    });
+
+    check_errors(db);
+    std::cout << "(checksum " << sum + callback_sum << ")\n";
+}
+
+/// Insert and scan workloads, first with the default allocator, then with sqlite3_allocator;
+/// SQLite is shut down in between, so it should be the last workload
+void allocator_workloads(bench_harness& harness, size_t rows)
+{
+    const size_t scans = 10;
+    const size_t threads = 4;
+    for (const bool pooled : { false, true }) {
+        sqlite3_shutdown();
+        if (pooled && sqlite3_allocator::install() != SQLITE_OK) {
+            std::cout << "Error installing sqlite3_allocator\n";
+            return;
+        }
+        const std::string suffix = pooled ? ", sqlite3_allocator" : ", default";
+        {
+            sqlite3_helper db;
+            create_database(db, "WAL");
+            sqlite3_helper::bulk_inserter<FileRecord> inserter(db, "files", { "filename", "entropy" });
+            harness.run("alloc insert: bulk_inserter" + suffix, rows, [&](size_t i) {
+                inserter.add(make_record(i));
+            });
+            inserter.flush();
+
+            double sum = 0.0;
+            harness.run("alloc scan: query()" + suffix, scans, [&](size_t) {
+                for (auto row : db.query("SELECT filename, entropy FROM files")) {
+                    sum += static_cast<double>(row.get_text(0).size()) + row.get_double(1);
+                }
+            }, rows);
+
+            harness.run("alloc scan: query_as(), 4 threads" + suffix, scans, [&](size_t) {
+                std::vector<std::thread> readers;
+                for (size_t t = 0; t < threads; ++t) {
+                    readers.emplace_back([] {
+                        sqlite3_helper reader(bench_database);
+                        std::vector<FileRecord> records = reader.query_as<FileRecord>("SELECT filename, entropy FROM files");
+                        check_errors(reader);
+                    });
+                }
+                for (std::thread& reader : readers) {
+                    reader.join();
+                }
+            }, rows * threads);
+            check_errors(db);
+            std::cout << "(checksum " << sum << ")\n";
+        }
+    }
+
+    sqlite3_shutdown();
+    const sqlite3_allocator_stats stats = sqlite3_allocator::get_stats();
+    sqlite3_allocator::uninstall();
+    std::cout << "sqlite3_allocator: " << stats.allocations << " allocations, "
+        << stats.pool_allocations << " from pools, " << stats.fallback_allocations << " from malloc, "
+        << stats.slab_refills << " slabs, " << stats.depot_refills << " depot refills\n";
+}
+
+/// Usage: sqlite3_helper_bench [rows]
+int main(int argc, char* argv[])
+{
+    const size_t rows = (argc > 1) ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 100000;
+    const size_t autocommit_rows = std::max<size_t>(1, rows / 100);
+    const size_t lookups = std::max<size_t>(100, rows);
+
+    bench_harness harness;
+    bench_harness::header();
+    insert_workloads(harness, rows, autocommit_rows);
+    journal_workloads(harness, autocommit_rows);
+    read_workloads(harness, rows, lookups);
+    allocator_workloads(harness, rows);
+
+    std::remove(bench_database);
+    std::remove((std::string(bench_database) + "-wal").c_str());
+    std::remove((std::string(bench_database) + "-shm").c_str());
+    return 0;
+}
@@ -1,216 +1,1076 @@
-﻿#include "sqlite3_helper.h"
-#include <iostream>
-#include <string>
-#include <vector>
-#include <cassert>
-#include <map>
-#include <codecvt>
-#include <sstream>
-
-// @brief Structure for table record
-struct FileInfo
-{
-    std::wstring path;
-    double entropy;
-};
-
-/// @brief Singleton for receiving database records from callback
-class FileTableReceiver
-{
-public:
-    
-    // @brief Meyers singleton
-    static FileTableReceiver& instance()
-    {
-        static FileTableReceiver receiver;
-        return receiver;
-    }
-
-    void add_row(const char* filename, const char* entropy)
-    {
-        std::wstring_convert<std::codecvt_utf8<wchar_t>> cv;
-        std::wstring wfilename = cv.from_bytes(std::string(filename));
-
-        try{
-            rows[wfilename] = std::stof(std::string(entropy));
-        }
-        catch (const std::invalid_argument&){
-            rows[wfilename] = -1.0;
-        }
-    }
-
-    /// @just to see the result
-    const std::map<std::wstring, float>& get_table()
-    {
-        return rows;
-    }
-
-    /// @brief accept one record, every cell is in string representation
-    /// That's why every new table should have own callback
-    /// @param raw_data: any additional data for the record
-    /// @param column_count: fields in query (not in the whole record) 
-    /// @param column_values: values in UTF-8 encoding
-    /// @param column_name: field names
-    static int select_callback(void *raw_data, int column_count, char **column_values, char **column_name);
-
-private:
-    FileTableReceiver() = default;
-    ~FileTableReceiver() = default;
-
-    /// Save table here
-    std::map<std::wstring, float> rows;
-};
-
-// static 
-int FileTableReceiver::select_callback(void *raw_data, int column_count, char **column_values, char **column_name)
-{
-    const int finename_column = 0;
-    const int entropy_column = 1;
-    assert(std::string(column_name[finename_column]) == "filename");
-    assert(std::string(column_name[entropy_column]) == "entropy");
-    std::string path(column_values[finename_column]);
-    std::string entropy(column_values[entropy_column]);
-    FileTableReceiver::instance().add_row(path.c_str(), entropy.c_str());
-    return 0;
-}
-
-/// Just display the error code and message if the last operation failed
-void check_errors(const sqlite3_helper& db)
-{
-    if (db.get_last_error() != SQLITE_OK) {
-        std::cout << "Error executing SQL on closed database, code = " << db.get_last_error()
-            << "; description: " << db.get_last_error_message() << '\n';
-    }
-}
-
-/// Show query results
-void select_results()
-{
-    const auto& files_fable = FileTableReceiver::instance().get_table();
-    for (const auto& item : files_fable) {
-        std::wcout << L'|' << item.first << L'|' << item.second << L'|' << std::endl;
-    }
-}
-
-/// Test with multiple encoding text records
-void unicode_test()
-{
-    sqlite3_helper db("unicode_files.db");
-    if (!db) {
-        check_errors(db);
-    }
-    else {
-        std::cout << "Open database successfully\n\n";
-    }
-
-    std::cout << "Set UTF-8 as charset\n";
-    db.exec(R"(PRAGMA encoding = "UTF-8")");
-    check_errors(db);
-
-    db.exec("DROP TABLE IF EXISTS files");
-    check_errors(db);
-
-    std::cout << "Perform CREATE TABLE\n";
-    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT, entropy REAL)");
-    check_errors(db);
-
-    std::vector<FileInfo> paths{
-        { FileInfo{{ L"'Im just a file.txt'" }, 4.01}},
-        { FileInfo{{ L"'Bröther may I have some lööps.docx'" }, 4.98}},
-        { FileInfo{{ L"'Бутылка для рашкована (Чечня круто).mp4'" }, 5.94}},
-        { FileInfo{{ L"'אלברט איינשטיין.pdf'" }, 7.98}},
-        { FileInfo{{ L"'西伯利亚是中国人.map'" }, 2.22}}
-    };
-
-    std::wstring_convert<std::codecvt_utf8<wchar_t>> cv;
-    
-    for (const FileInfo& file_info : paths) {
-        std::wstringstream wss;
-        wss << L"INSERT INTO files(filename, entropy) VALUES ("
-            << file_info.path << L", "
-            << file_info.entropy << L")";
-        std::wstring wsql(wss.str());
-        std::string sql = cv.to_bytes(wsql);
-        db.exec(sql.c_str());
-        check_errors(db);
-    }
-
-    db.exec("SELECT filename, entropy FROM files", &FileTableReceiver::select_callback);
-    check_errors(db);
-    // Do not perform select_results() because of multiple locales
-}
-
-/// Simple test, create database, insert, select, text error handling (operations on closed database)
-void simple_test()
-{
-    if (sqlite3_helper::is_threadsafe()) {
-        std::cout << "Sqlite3 build is threadsafe\n";
-    }
-    else {
-        std::cout << "Sqlite3 build is not threadsafe!\n";
-    }
-
-    sqlite3_helper db("files.db");
-    if (!db) {
-        check_errors(db);
-    }
-    else {
-        std::cout << "Open database successfully\n\n";
-    }
-    db.exec("drop table filetable");
-    check_errors(db);
-
-    std::cout << "Perform CREATE TABLE\n";
-
-    // check CREATE TABLE query
-    db.exec("CREATE TABLE filetable(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT, entropy REAL)");
-    check_errors(db);
-
-    std::cout << "Perform INSERT INTO\n";
-
-    // check INSERT INTO query
-    db.exec("INSERT INTO filetable(filename, entropy) VALUES ('C:/Temp/usernames.txt', 1.35)");
-    check_errors(db);
-
-    db.exec("INSERT INTO filetable(filename, entropy) VALUES ('C:/Windows/system32/abc.dll', 6.05)");
-    check_errors(db);
-
-    std::cout << "Perform SELECT\n";
-
-    // check SELECT query
-    db.exec("SELECT filename, entropy FROM filetable", &FileTableReceiver::select_callback);
-    check_errors(db);
-    select_results();
-
-    std::cout << "Perform UPDATE\n";
-
-    // check UPDATE query
-    db.exec("UPDATE filetable SET entropy = 7.23 WHERE id=1");
-    check_errors(db);
-
-    std::cout << "Perform SELECT after UPDATE\n";
-
-    // check SELECT query
-    db.exec("SELECT filename, entropy FROM filetable", &FileTableReceiver::select_callback);
-    check_errors(db);
-    select_results();
-
-    std::cout << "Check error handling on closed database\n";
-
-    // check error handling
-    db.close();
-
-    db.exec("INSERT INTO filetable(filename, entropy) VALUES ('C:/Temp/usernames.txt', 1.35)");
-    check_errors(db);
-}
-
-int main()
-{
-    // Perform simple database creation test and error handling
-    simple_test();
-
-    // Perform test with Unicode data converting into UTF-8
-    unicode_test();
-
-    return 0;
-}
+﻿#include "sqlite3_helper.h"
+#include "sqlite3_allocator.h"
+#include "sqlite3_async_executor.h"
+#include "sqlite3_blob_stream.h"
+#include "sqlite3_carray.h"
+#include "sqlite3_page_cache.h"
+#include "sqlite3_lookaside_tuner.h"
+#include "sqlite3_pool.h"
+#include "sqlite3_profiler.h"
+#include "sqlite3_stats_sampler.h"
+#include "sqlite3_wal_manager.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <map>
+#include <codecvt>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <locale>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+// @brief Structure for table record
+struct FileInfo
+{
+    std::wstring path;
+    double entropy;
+};
+
+/// @brief Singleton for receiving database records from callback
+class FileTableReceiver
+{
+public:
+    
+    // @brief Meyers singleton
+    static FileTableReceiver& instance()
+    {
+        static FileTableReceiver receiver;
+        return receiver;
+    }
+
+    void add_row(const char* filename, const char* entropy)
+    {
+        std::wstring_convert<std::codecvt_utf8<wchar_t>> cv;
+        std::wstring wfilename = cv.from_bytes(std::string(filename));
+
+        try{
+            rows[wfilename] = std::stof(std::string(entropy));
+        }
+        catch (const std::invalid_argument&){
+            rows[wfilename] = -1.0;
+        }
+    }
+
+    /// @just to see the result
+    const std::map<std::wstring, float>& get_table()
+    {
+        return rows;
+    }
+
+    /// @brief accept one record, every cell is in string representation
+    /// That's why every new table should have own callback
+    /// @param raw_data: any additional data for the record
+    /// @param column_count: fields in query (not in the whole record) 
+    /// @param column_values: values in UTF-8 encoding
+    /// @param column_name: field names
+    static int select_callback(void *raw_data, int column_count, char **column_values, char **column_name);
+
+private:
+    FileTableReceiver() = default;
+    ~FileTableReceiver() = default;
+
+    /// Save table here
+    std::map<std::wstring, float> rows;
+};
+
+// static 
+int FileTableReceiver::select_callback(void *raw_data, int column_count, char **column_values, char **column_name)
+{
+    const int finename_column = 0;
+    const int entropy_column = 1;
+    assert(std::string(column_name[finename_column]) == "filename");
+    assert(std::string(column_name[entropy_column]) == "entropy");
+    std::string path(column_values[finename_column]);
+    std::string entropy(column_values[entropy_column]);
+    FileTableReceiver::instance().add_row(path.c_str(), entropy.c_str());
+    return 0;
+}
+
+/// Just display the error code and message if the last operation failed
+void check_errors(const sqlite3_helper& db)
+{
+    if (db.get_last_error() != SQLITE_OK) {
+        std::cout << "Error executing SQL on closed database, code = " << db.get_last_error()
+            << "; description: " << db.get_last_error_message() << '\n';
+    }
+}
+
+/// Number of failed checks, main() fails if any
+int failed_checks = 0;
+
+/// Display the description if the check failed
+void verify(bool condition, const char* description)
+{
+    if (!condition) {
+        ++failed_checks;
+        std::cout << "Check failed: " << description << '\n';
+    }
+}
+
+/// Show query results
+void select_results()
+{
+    const auto& files_fable = FileTableReceiver::instance().get_table();
+    for (const auto& item : files_fable) {
+        std::wcout << L'|' << item.first << L'|' << item.second << L'|' << std::endl;
+    }
+}
+
+/// Test with multiple encoding text records
+void unicode_test()
+{
+    sqlite3_helper db("unicode_files.db");
+    if (!db) {
+        check_errors(db);
+    }
+    else {
+        std::cout << "Open database successfully\n\n";
+    }
+
+    std::cout << "Set UTF-8 as charset\n";
+    db.exec(R"(PRAGMA encoding = "UTF-8")");
+    check_errors(db);
+
+    db.exec("DROP TABLE IF EXISTS files");
+    check_errors(db);
+
+    std::cout << "Perform CREATE TABLE\n";
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT, entropy REAL)");
+    check_errors(db);
+
+    std::vector<FileInfo> paths{
+        { FileInfo{{ L"'Im just a file.txt'" }, 4.01}},
+        { FileInfo{{ L"'Bröther may I have some lööps.docx'" }, 4.98}},
+        { FileInfo{{ L"'Бутылка для рашкована (Чечня круто).mp4'" }, 5.94}},
+        { FileInfo{{ L"'אלברט איינשטיין.pdf'" }, 7.98}},
+        { FileInfo{{ L"'西伯利亚是中国人.map'" }, 2.22}}
+    };
+
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> cv;
+    
+    for (const FileInfo& file_info : paths) {
+        std::wstringstream wss;
+        wss << L"INSERT INTO files(filename, entropy) VALUES ("
+            << file_info.path << L", "
+            << file_info.entropy << L")";
+        std::wstring wsql(wss.str());
+        std::string sql = cv.to_bytes(wsql);
+        db.exec(sql.c_str());
+        check_errors(db);
+    }
+
+    db.exec("SELECT filename, entropy FROM files", &FileTableReceiver::select_callback);
+    check_errors(db);
+    // Do not perform select_results() because of multiple locales
+}
+
+/// Simple test, create database, insert, select, text error handling (operations on closed database)
+void simple_test()
+{
+    if (sqlite3_helper::is_threadsafe()) {
+        std::cout << "Sqlite3 build is threadsafe\n";
+    }
+    else {
+        std::cout << "Sqlite3 build is not threadsafe!\n";
+    }
+
+    sqlite3_helper db("files.db");
+    if (!db) {
+        check_errors(db);
+    }
+    else {
+        std::cout << "Open database successfully\n\n";
+    }
+    db.exec("drop table filetable");
+    check_errors(db);
+
+    std::cout << "Perform CREATE TABLE\n";
+
+    // check CREATE TABLE query
+    db.exec("CREATE TABLE filetable(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT, entropy REAL)");
+    check_errors(db);
+
+    std::cout << "Perform INSERT INTO\n";
+
+    // check INSERT INTO query
+    db.exec("INSERT INTO filetable(filename, entropy) VALUES ('C:/Temp/usernames.txt', 1.35)");
+    check_errors(db);
+
+    db.exec("INSERT INTO filetable(filename, entropy) VALUES ('C:/Windows/system32/abc.dll', 6.05)");
+    check_errors(db);
+
+    std::cout << "Perform SELECT\n";
+
+    // check SELECT query
+    db.exec("SELECT filename, entropy FROM filetable", &FileTableReceiver::select_callback);
+    check_errors(db);
+    select_results();
+
+    std::cout << "Perform UPDATE\n";
+
+    // check UPDATE query
+    db.exec("UPDATE filetable SET entropy = 7.23 WHERE id=1");
+    check_errors(db);
+
+    std::cout << "Perform SELECT after UPDATE\n";
+
+    // check SELECT query
+    db.exec("SELECT filename, entropy FROM filetable", &FileTableReceiver::select_callback);
+    check_errors(db);
+    select_results();
+
+    std::cout << "Check error handling on closed database\n";
+
+    // check error handling
+    db.close();
+
+    db.exec("INSERT INTO filetable(filename, entropy) VALUES ('C:/Temp/usernames.txt', 1.35)");
+    check_errors(db);
+}
+
+/// Prepared statement test, compile INSERT once and execute it for every record
+void prepared_statement_test()
+{
+    sqlite3_helper db("prepared_files.db");
+    check_errors(db);
+
+    db.exec("DROP TABLE IF EXISTS files");
+    check_errors(db);
+
+    std::cout << "Perform CREATE TABLE\n";
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT, entropy REAL)");
+    check_errors(db);
+
+    std::cout << "Perform prepared INSERT INTO\n";
+    sqlite3_helper::statement insert = db.prepare("INSERT INTO files(filename, entropy) VALUES (?, ?)");
+    if (!insert) {
+        std::cout << "Error preparing statement, code = " << insert.get_last_error() << '\n';
+        return;
+    }
+
+    const std::vector<std::pair<std::string, double>> files{
+        { "C:/Temp/usernames.txt", 1.35 },
+        { "C:/Windows/system32/abc.dll", 6.05 },
+        { "C:/Windows/system32/kernel32.dll", 6.52 }
+    };
+    for (const auto& file : files) {
+        if (insert.exec(file.first, file.second) != SQLITE_OK) {
+            std::cout << "Error executing statement, code = " << insert.get_last_error() << '\n';
+        }
+    }
+
+    std::cout << "Perform prepared SELECT\n";
+    sqlite3_helper::statement select = db.prepare("SELECT filename, entropy FROM files WHERE entropy > ?");
+    select.bind(1, 5.0);
+    while (select.step() == SQLITE_ROW) {
+        std::cout << '|' << select.column<std::string>(0) << '|' << select.column<double>(1) << "|\n";
+    }
+
+    std::cout << "Perform SELECT with typed row iteration\n";
+    for (auto row : db.query("SELECT filename, entropy FROM files WHERE entropy < ?", 5.0)) {
+        std::cout << '|' << row.get_text(0) << '|' << row.get_double(1) << "|\n";
+    }
+    check_errors(db);
+
+    std::cout << "Perform SELECT into vector of tuples\n";
+    const auto files_table = db.query_as<std::tuple<std::string, double>>("SELECT filename, entropy FROM files");
+    check_errors(db);
+    for (const auto& file : files_table) {
+        std::cout << '|' << std::get<0>(file) << '|' << std::get<1>(file) << "|\n";
+    }
+
+    std::cout << "Check empty text is bound as '' and not as NULL\n";
+    sqlite3_helper::statement text_type = db.prepare("SELECT typeof(?), typeof(?)");
+    text_type.bind(1, std::string_view());
+    text_type.bind(2, std::string());
+    verify(text_type.step() == SQLITE_ROW, "SELECT typeof(?) returns a row");
+    verify(text_type.column<std::string>(0) == "text", "empty std::string_view is bound as text");
+    verify(text_type.column<std::string>(1) == "text", "empty std::string is bound as text");
+
+    std::cout << "Check shared buffers are bound without copy and released by SQLite\n";
+    const std::vector<unsigned char> header{ 0x4d, 0x5a, 0x90, 0x00 };
+    const auto filename = std::make_shared<const std::string>("C:/Windows/system32/kernel32.dll");
+    sqlite3_helper::statement echo = db.prepare("SELECT ?, ?");
+    echo.bind(1, sqlite3_shared_text(filename));
+    echo.bind(2, sqlite3_shared_blob(std::vector<unsigned char>(header)));
+    verify(sqlite3_bound_buffers::size() == 2 && filename.use_count() == 2, "SQLite keeps bound buffers alive");
+    verify(echo.step() == SQLITE_ROW && echo.column<std::string>(0) == *filename, "shared text round-trips");
+    const sqlite3_blob_view blob = echo.column<sqlite3_blob_view>(1);
+    verify(std::vector<unsigned char>(blob.begin(), blob.end()) == header, "shared blob round-trips");
+    echo.reset();
+    echo.bind(1, sqlite3_shared_text(std::string("C:/Temp/usernames.txt")));
+    verify(sqlite3_bound_buffers::size() == 2 && filename.use_count() == 1, "rebinding releases the previous buffer");
+    echo.finalize();
+    verify(sqlite3_bound_buffers::size() == 0, "finalize releases all bound buffers");
+}
+
+/// Statement cache test, repeated SQL is compiled once and taken from the cache afterwards
+void statement_cache_test()
+{
+    sqlite3_helper db(":memory:");
+    db.set_statement_cache_capacity(8);
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY, filename TEXT)");
+    check_errors(db);
+
+    std::cout << "Perform cached INSERT INTO\n";
+    for (int i = 0; i < 10; ++i) {
+        sqlite3_helper::statement insert = db.prepare_cached("INSERT INTO files(filename) VALUES (?)");
+        insert.exec("C:/Temp/usernames.txt");
+    }
+    sqlite3_helper::statement_cache_stats stats = db.get_statement_cache_stats();
+    verify(stats.misses == 2 && stats.hits == 9, "repeated SQL is compiled once");
+
+    std::cout << "Check SQL with several statements bypasses the cache\n";
+    for (int i = 0; i < 3; ++i) {
+        sqlite3_helper::statement several = db.prepare_cached("SELECT 1; SELECT 2");
+        verify(several.handle() == nullptr && several.get_last_error() == SQLITE_OK, "several statements are not cached");
+    }
+    stats = db.get_statement_cache_stats();
+    verify(stats.misses == 2 && stats.bypassed == 3, "several statements are not counted as misses");
+
+    std::cout << "Check borrowed statement outlives the helper\n";
+    sqlite3_helper::statement borrowed;
+    {
+        sqlite3_helper owner(":memory:");
+        owner.set_statement_cache_capacity(4);
+        borrowed = owner.prepare_cached("SELECT 42");
+        verify(owner.close() == SQLITE_OK && owner.handle() == nullptr, "connection with a borrowed statement is released");
+        verify(owner.open(":memory:") == SQLITE_OK && owner.prepare_cached("SELECT 42").handle() != borrowed.handle(),
+            "reopened connection does not share the old cache");
+    }
+    verify(borrowed.step() == SQLITE_ROW && borrowed.column<int>(0) == 42, "borrowed statement runs after the helper is destroyed");
+    verify(borrowed.finalize() == SQLITE_OK, "returning the last statement closes the connection");
+}
+
+/// Profiler test, runs of one statement and statements differing only by literals are aggregated by fingerprint
+void profiler_test()
+{
+    sqlite3_helper db(":memory:");
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY, filename TEXT)");
+    check_errors(db);
+
+    sqlite3_profiler_options options;
+    options.count_rows = true;
+    sqlite3_profiler profiler(db, options);
+    verify(profiler.is_valid(), "profiler installs trace callback");
+
+    std::cout << "Perform profiled prepared INSERT INTO\n";
+    {
+        sqlite3_helper::statement insert = db.prepare("INSERT INTO files(filename) VALUES (?)");
+        for (int i = 0; i < 10; ++i) {
+            insert.exec("C:/Temp/usernames.txt");
+        }
+    }
+    verify(profiler.get_snapshot("INSERT INTO files(filename) VALUES (?)").count == 10, "runs of a prepared statement are aggregated");
+
+    std::cout << "Check statement prepared after the finalized one is profiled separately\n";
+    {
+        sqlite3_helper::statement remove = db.prepare("DELETE FROM files WHERE id = ?");
+        remove.exec(9);
+        remove.exec(10);
+    }
+    verify(profiler.get_snapshot("DELETE FROM files WHERE id = ?").count == 2, "new statement has own fingerprint");
+    verify(profiler.get_snapshot("INSERT INTO files(filename) VALUES (?)").count == 10, "finalized statement counters are kept");
+
+    std::cout << "Check literals are replaced in fingerprint\n";
+    for (int i = 1; i <= 3; ++i) {
+        db.exec(("SELECT filename FROM files WHERE id <= " + std::to_string(i)).c_str());
+    }
+    const sqlite3_latency_snapshot select = profiler.get_snapshot("SELECT filename FROM files WHERE id <= 1");
+    verify(select.count == 3 && select.rows == 6, "queries with different literals share fingerprint");
+    verify(profiler.report().find(select.sql) != std::string::npos, "report lists the fingerprint");
+}
+
+/// Statistics test, connection counters are reset separately from process-wide ones and sampled into files
+void stats_test()
+{
+    sqlite3_helper db(":memory:");
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY, filename TEXT)");
+    db.exec("INSERT INTO files(filename) VALUES ('C:/Temp/usernames.txt')");
+    check_errors(db);
+
+    std::cout << "Check connection reset keeps process-wide high-water marks\n";
+    db.exec("SELECT randomblob(1000000)");
+    const sqlite3_helper::statistics before = db.stats(true);
+    const sqlite3_helper::statistics after = db.stats();
+    verify(db.is_valid() && after.cache_hit == 0 && after.cache_miss == 0, "connection counters are reset");
+    verify(after.memory_used.highwater >= before.memory_used.highwater, "process-wide high-water mark is kept");
+    verify(sqlite3_helper::reset_process_stats() == SQLITE_OK, "process-wide counters are reset explicitly");
+
+    std::cout << "Perform statistics sampling into files\n";
+    sqlite3_stats_sampler_options options;
+    options.interval = std::chrono::milliseconds(60000);
+    options.prometheus_file = "stats.prom";
+    options.json_file = "stats.json";
+    sqlite3_stats_sampler sampler(db, options);
+    verify(sampler.sample() == SQLITE_OK && sampler.get_sample_count() >= 1, "sample is taken");
+    std::ifstream prometheus(options.prometheus_file);
+    std::stringstream prometheus_text;
+    prometheus_text << prometheus.rdbuf();
+    verify(prometheus_text.str().find("sqlite_cache_hits_total{db=\"main\"}") != std::string::npos, "Prometheus file is written");
+    std::ifstream json(options.json_file);
+    std::stringstream json_text;
+    json_text << json.rdbuf();
+    verify(json_text.str().find("\"memory_used_bytes\": ") != std::string::npos, "JSON file is written");
+}
+
+/// Backup test, a database is copied into another connection and into a file
+void backup_test()
+{
+    sqlite3_helper db(":memory:");
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT)");
+    db.exec("INSERT INTO files(filename) VALUES ('C:/Temp/usernames.txt'), ('C:/Windows/system32/abc.dll')");
+    check_errors(db);
+
+    std::cout << "Perform backup into a file\n";
+    sqlite3_helper::backup_options options;
+    options.pages_per_step = 1;
+    verify(db.backup_to_file("backup_files.db", options) == SQLITE_OK, "database is copied into a file");
+    sqlite3_helper copy("backup_files.db");
+    verify(copy.query_as<std::tuple<std::string>>("SELECT filename FROM files").size() == 2, "file has the copied rows");
+
+    std::cout << "Check backup into a closed connection\n";
+    sqlite3_helper closed;
+    verify(db.backup_to(closed) == SQLITE_MISUSE, "closed destination is misuse");
+    verify(closed.backup_to(copy) == SQLITE_MISUSE && copy.is_valid(), "closed source is misuse");
+}
+
+#ifdef SQLITE3_HELPER_DESERIALIZE
+/// Snapshot test, a serialized database is saved into a file and loaded back
+void snapshot_test()
+{
+    sqlite3_helper db(":memory:");
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT)");
+    db.exec("INSERT INTO files(filename) VALUES ('C:/Temp/usernames.txt'), ('C:/Windows/system32/abc.dll')");
+    check_errors(db);
+
+    std::cout << "Perform snapshot save and load\n";
+    const sqlite3_helper::image snapshot = db.serialize();
+    verify(!snapshot.empty() && snapshot.save("snapshot_files.db") == SQLITE_OK, "snapshot is saved");
+    db.exec("INSERT INTO files(filename) VALUES ('C:/Windows/system32/kernel32.dll')");
+    verify(db.serialize().save("snapshot_files.db") == SQLITE_OK, "snapshot replaces the existing file");
+
+    sqlite3_helper::image loaded;
+    verify(loaded.load("snapshot_files.db") == SQLITE_OK, "snapshot is loaded");
+    sqlite3_helper restored(":memory:");
+    verify(restored.deserialize(std::move(loaded)) == SQLITE_OK, "snapshot is deserialized");
+    verify(restored.query_as<std::tuple<std::string>>("SELECT filename FROM files").size() == 3, "snapshot has the last rows");
+}
+#endif
+
+/// BLOB stream test, a preallocated BLOB is written and read back through std::ostream and std::istream
+void blob_stream_test()
+{
+    sqlite3_helper db(":memory:");
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY, content BLOB)");
+    const size_t size = 300000;
+    sqlite3_helper::statement insert = db.prepare("INSERT INTO files(id, content) VALUES (1, ?)");
+    verify(insert.exec(sqlite3_zeroblob{ size }) == SQLITE_OK, "zero-filled BLOB is inserted");
+
+    std::string content(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        content[i] = static_cast<char>('a' + i % 26);
+    }
+
+    std::cout << "Perform BLOB write in small and large chunks\n";
+    {
+        sqlite3_blob_stream blob(db, "files", "content", 1, true);
+        verify(blob.is_valid() && blob.size() == static_cast<int>(size), "BLOB is opened for writing");
+        sqlite3_blob_ostream output(blob, 4096);
+        output.write(content.data(), 100);
+        output.write(content.data() + 100, 200000);
+        output.write(content.data() + 200100, static_cast<std::streamsize>(size - 200100));
+        output.flush();
+        verify(output.good(), "BLOB is written");
+        output.put('x');
+        output.flush();
+        verify(!output.good(), "write past the end of BLOB fails");
+    }
+
+    std::cout << "Perform BLOB read in small and large chunks\n";
+    sqlite3_blob_stream blob(db, "files", "content", 1);
+    sqlite3_blob_istream input(blob, 4096);
+    std::string read(size, '\0');
+    input.read(&read[0], 10);
+    input.read(&read[10], 250000);
+    input.read(&read[250010], static_cast<std::streamsize>(size - 250010));
+    verify(input.gcount() == static_cast<std::streamsize>(size - 250010) && read == content, "BLOB reads back the written bytes");
+    input.seekg(26 * 1000 + 3);
+    verify(input.get() == 'd', "seek moves to the byte");
+}
+
+/// carray() test, IN-lists of any size are served by one prepared statement with a bound container
+void carray_test()
+{
+    sqlite3_helper db(":memory:");
+    verify(sqlite3_carray::create_module(db) == SQLITE_OK, "carray() is registered");
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY, filename TEXT)");
+    db.exec("INSERT INTO files(id, filename) VALUES (1, 'C:/Temp/usernames.txt'), (2, 'C:/Windows/system32/abc.dll'), "
+        "(3, 'C:/Windows/system32/kernel32.dll')");
+    check_errors(db);
+
+    std::cout << "Perform SELECT with IN carray() of integers\n";
+    sqlite3_helper::statement select = db.prepare("SELECT count(*) FROM files WHERE id IN carray(?)");
+    const std::vector<int64_t> ids{ 1, 3, 5 };
+    select.bind(1, sqlite3_carray_ref<int64_t>(ids));
+    verify(select.step() == SQLITE_ROW && select.column<int>(0) == 2, "int64_t elements are matched");
+    select.reset();
+    const std::vector<sqlite3_int64> sqlite_ids{ 1, 2, 3 };
+    select.bind(1, sqlite3_carray_ref<sqlite3_int64>(sqlite_ids));
+    verify(select.step() == SQLITE_ROW && select.column<int>(0) == 3, "sqlite3_int64 elements are matched");
+    select.reset();
+
+    std::cout << "Perform SELECT with IN carray() of text\n";
+    const std::vector<std::string> names{ "C:/Temp/usernames.txt", "C:/Temp/missing.txt" };
+    const auto found = db.query_as<std::tuple<int>>("SELECT id FROM files WHERE filename IN carray(?)", sqlite3_carray_ref<std::string>(names));
+    verify(found.size() == 1 && std::get<0>(found[0]) == 1, "std::string elements are matched");
+
+    std::cout << "Check carray() without argument\n";
+    sqlite3_helper::statement unbound = db.prepare("SELECT value FROM carray");
+    verify(!unbound && unbound.get_last_error() == SQLITE_ERROR, "carray() without argument is not planned");
+}
+
+/// Bulk insertion test, a failed batch rolls back the inserter transaction and the connection stays usable
+void bulk_insert_test()
+{
+    sqlite3_helper db(":memory:");
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY, filename TEXT UNIQUE)");
+    check_errors(db);
+
+    std::cout << "Perform bulk INSERT INTO\n";
+    {
+        sqlite3_helper::bulk_inserter<std::tuple<std::string>> inserter(db, "files", { "filename" });
+        for (int i = 0; i < 1000; ++i) {
+            inserter.add(std::make_tuple("C:/Temp/file" + std::to_string(i) + ".txt"));
+        }
+        verify(inserter.flush() == SQLITE_OK && inserter.get_rows_inserted() == 1000, "bulk inserter inserts all rows");
+    }
+
+    std::cout << "Check failed batch is rolled back\n";
+    {
+        sqlite3_helper::bulk_insert_options options;
+        options.rows_per_statement = 10;
+        sqlite3_helper::bulk_inserter<std::tuple<std::string>> inserter(db, "files", { "filename" }, options);
+        for (int i = 0; i < 25; ++i) {
+            // Row 15 violates UNIQUE constraint
+            inserter.add(std::make_tuple("C:/Temp/file" + std::to_string(i == 15 ? 0 : 1000 + i) + ".txt"));
+        }
+        verify(inserter.get_last_error() == SQLITE_CONSTRAINT, "duplicate row fails the batch");
+        verify(inserter.get_rows_inserted() == 0, "rows of the failed transaction are not counted");
+    }
+    verify(sqlite3_get_autocommit(db.handle()) != 0, "failed batch does not leave the inserter transaction open");
+
+    {
+        sqlite3_helper::transaction guard(db);
+        verify(!guard.is_nested(), "transaction after failed batch is not a savepoint");
+        db.exec("INSERT INTO files(filename) VALUES ('C:/Temp/usernames.txt')");
+        verify(guard.commit() == SQLITE_OK, "transaction after failed batch commits");
+    }
+    const auto count = db.query_as<std::tuple<int>>("SELECT count(*) FROM files");
+    verify(count.size() == 1 && std::get<0>(count[0]) == 1001, "failed batch inserts nothing");
+}
+
+/// Connection settings test, journal mode which does not take effect fails the open
+void open_options_test()
+{
+    std::cout << "Check WAL is rejected for in-memory database\n";
+    sqlite3_helper memory_db(":memory:", sqlite3_helper::open_options::read_mostly());
+    verify(!memory_db && memory_db.get_last_error() == SQLITE_ERROR, "WAL preset fails on in-memory database");
+
+    sqlite3_helper bulk_db(":memory:", sqlite3_helper::open_options::bulk_load());
+    verify(bulk_db.is_valid() && bulk_db.get_journal_mode() == "memory", "MEMORY journal preset opens in-memory database");
+
+    sqlite3_helper file_db("options_files.db", sqlite3_helper::open_options::durable_oltp());
+    verify(file_db.is_valid() && file_db.get_journal_mode() == "wal", "WAL preset opens file database");
+}
+
+/// Busy policy test, a write blocked by another connection is retried until the lock is released or the deadline passes
+void busy_policy_test()
+{
+    sqlite3_helper holder("busy_files.db");
+    holder.exec("DROP TABLE IF EXISTS files");
+    holder.exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT)");
+    check_errors(holder);
+
+    sqlite3_helper::busy_policy policy;
+    policy.initial_delay = std::chrono::milliseconds(1);
+    policy.max_delay = std::chrono::milliseconds(10);
+    policy.timeout = std::chrono::milliseconds(100);
+    sqlite3_helper db("busy_files.db");
+    verify(db.set_busy_policy(policy) == SQLITE_OK, "busy policy is installed");
+
+    std::cout << "Check write gives up after the deadline\n";
+    holder.exec("BEGIN IMMEDIATE");
+    const auto started = std::chrono::steady_clock::now();
+    verify(db.exec("INSERT INTO files(filename) VALUES ('C:/Temp/usernames.txt')") == SQLITE_BUSY, "locked write returns SQLITE_BUSY");
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    sqlite3_helper::busy_stats stats = db.get_busy_stats();
+    verify(stats.busy_events == 1 && stats.retries > 0 && stats.timeouts == 1, "busy event is retried and timed out");
+    verify(stats.total_wait >= std::chrono::milliseconds(50) && elapsed >= std::chrono::milliseconds(50), "handler sleeps until the deadline");
+
+    std::cout << "Check write is retried until the lock is released\n";
+    std::thread committer([&holder] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        holder.exec("COMMIT");
+    });
+    verify(db.exec("INSERT INTO files(filename) VALUES ('C:/Temp/usernames.txt')") == SQLITE_OK, "write succeeds after the lock is released");
+    committer.join();
+    stats = db.get_busy_stats();
+    verify(stats.busy_events == 2 && stats.timeouts == 1, "released lock does not time out");
+
+    std::cout << "Check statement outliving the helper under a lock\n";
+    sqlite3_helper::statement orphan;
+    {
+        sqlite3_helper owner("busy_files.db");
+        orphan = owner.prepare("INSERT INTO files(filename) VALUES ('C:/Windows/system32/abc.dll')");
+        owner.set_busy_policy(policy);
+    }
+    holder.exec("BEGIN IMMEDIATE");
+    verify(orphan.step() == SQLITE_BUSY, "statement of a closed helper is not retried");
+    holder.exec("COMMIT");
+    orphan.finalize();
+}
+
+/// Connection pool test, readers and the writer are leased and returned, a waiting reader is woken up
+void pool_test()
+{
+    std::cout << "Check pool requires WAL\n";
+    sqlite3_pool memory_pool(":memory:", 1);
+    verify(memory_pool.get_last_error() == SQLITE_ERROR, "pool fails on in-memory database");
+
+    sqlite3_pool pool("pool_files.db", 2);
+    verify(pool.is_valid(), "pool opens file database");
+    if (!pool) {
+        return;
+    }
+
+    std::cout << "Perform INSERT INTO with the writer lease\n";
+    {
+        sqlite3_pool::writer_lease writer = pool.acquire_writer();
+        writer->exec("DROP TABLE IF EXISTS files");
+        writer->exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT, entropy REAL)");
+        writer->exec("INSERT INTO files(filename, entropy) VALUES ('C:/Temp/usernames.txt', 1.35), ('C:/Windows/system32/abc.dll', 6.05)");
+        check_errors(*writer);
+        verify(!pool.try_acquire_writer(), "only one writer lease at a time");
+    }
+
+    std::cout << "Check moved writer lease is released once\n";
+    sqlite3_pool::writer_lease moved_from = pool.acquire_writer();
+    sqlite3_pool::writer_lease moved_to;
+    moved_to = std::move(moved_from);
+    verify(!moved_from && moved_to, "moved-from writer lease is empty");
+    moved_to.release();
+    verify(!moved_to && pool.try_acquire_writer(), "writer is available after the moved lease is released");
+
+    std::cout << "Perform SELECT with reader leases\n";
+    sqlite3_pool::reader_lease first = pool.acquire_reader();
+    sqlite3_pool::reader_lease second = pool.acquire_reader();
+    verify(first && second && !pool.try_acquire_reader(), "every reader is leased once");
+    const auto files_table = first->query_as<std::tuple<std::string, double>>("SELECT filename, entropy FROM files");
+    verify(files_table.size() == 2, "reader sees rows committed by the writer");
+
+    std::cout << "Check waiting reader is woken up when a lease is returned\n";
+    bool leased = false;
+    std::thread waiting([&pool, &leased] {
+        leased = static_cast<bool>(pool.acquire_reader());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    second.release();
+    waiting.join();
+    verify(leased, "acquire_reader() waits for a returned reader");
+}
+
+/// Lookaside tuner test, pool readers are re-sized to the recommendation as they are returned
+void lookaside_tuner_test()
+{
+    sqlite3_lookaside_tuner_options tuner_options;
+    tuner_options.initial.slot_size = 64;
+    tuner_options.initial.slot_count = 500;
+    tuner_options.warmup_samples = 1;
+    sqlite3_lookaside_tuner tuner(tuner_options);
+    sqlite3_pool pool("lookaside_files.db", 1, sqlite3_helper::open_options(), &tuner);
+    verify(pool.is_valid(), "pool with lookaside tuner opens");
+    if (!pool) {
+        return;
+    }
+    {
+        sqlite3_pool::writer_lease writer = pool.acquire_writer();
+        writer->exec("DROP TABLE IF EXISTS files");
+        writer->exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT)");
+        writer->exec("INSERT INTO files(filename) VALUES ('C:/Temp/usernames.txt'), ('C:/Windows/system32/abc.dll')");
+        check_errors(*writer);
+    }
+
+    std::cout << "Check reader returned with own statement stays valid\n";
+    sqlite3_pool::reader_lease reader = pool.acquire_reader();
+    sqlite3_helper::statement kept = reader->prepare("SELECT filename FROM files ORDER BY filename");
+    verify(kept.step() == SQLITE_ROW, "own statement of the lease holder runs");
+    reader.release();
+    verify(tuner.get_generation() == 1, "warm-up window gives a new recommendation");
+    reader = pool.acquire_reader();
+    verify(reader && reader->is_valid(), "busy lookaside does not fail the next lease");
+
+    std::cout << "Check reader is re-sized once own statements are finalized\n";
+    kept.finalize();
+    reader.release();
+    reader = pool.acquire_reader();
+    verify(reader && reader->is_valid() && reader->query_as<std::tuple<std::string>>("SELECT filename FROM files").size() == 2,
+        "re-sized reader runs queries");
+}
+
+/// WAL manager test, large WAL is checkpointed in background and escalated to RESTART when writers are idle
+void wal_manager_test()
+{
+    sqlite3_helper db("wal_files.db");
+    db.exec("DROP TABLE IF EXISTS files");
+    db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT, entropy REAL)");
+    check_errors(db);
+
+    sqlite3_wal_checkpoint_options options;
+    options.restart_pages = 16;
+    options.idle_interval = std::chrono::milliseconds(50);
+    sqlite3_wal_manager manager(db, options);
+    verify(manager.is_valid(), "WAL manager starts");
+    if (!manager) {
+        return;
+    }
+
+    std::cout << "Perform INSERT INTO in WAL mode\n";
+    sqlite3_helper::statement insert = db.prepare("INSERT INTO files(filename, entropy) VALUES (?, ?)");
+    for (int transaction = 0; transaction < 20; ++transaction) {
+        sqlite3_helper::transaction guard(db);
+        for (int i = 0; i < 100; ++i) {
+            insert.exec(std::string(100, 'f') + std::to_string(i), 1.35);
+        }
+        guard.commit();
+    }
+    verify(manager.get_wal_pages() >= options.restart_pages, "commits grow WAL");
+
+    std::cout << "Check idle checkpoint is escalated\n";
+    sqlite3_wal_checkpoint_stats stats = manager.get_stats();
+    for (int wait = 0; wait < 100 && stats.restart == 0; ++wait) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        stats = manager.get_stats();
+    }
+    verify(stats.passive >= 1 && stats.restart >= 1 && stats.truncate == 0, "idle checkpoint is escalated to RESTART");
+    verify(stats.busy == 0 && stats.failed == 0, "checkpoints without readers are not busy");
+    verify(stats.last_checkpointed_frames == stats.last_log_frames, "whole WAL is checkpointed");
+}
+
+/// Asynchronous executor test, queries run on worker connections and failures are reported through futures
+void async_executor_test()
+{
+    std::cout << "Perform SELECT on worker connections\n";
+    {
+        sqlite3_async_executor executor("async_files.db", 2);
+        verify(executor.is_valid(), "executor opens worker connections");
+        executor.exec("DROP TABLE IF EXISTS files").wait();
+        executor.exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT, entropy REAL)").wait();
+        verify(executor.exec("INSERT INTO files(filename, entropy) VALUES ('C:/Temp/usernames.txt', 1.35)").get() == SQLITE_OK,
+            "INSERT INTO runs on a worker");
+        const auto result = executor.query_as<std::tuple<std::string, double>>("SELECT filename, entropy FROM files WHERE entropy < ?", 5.0).get();
+        verify(result.return_code == SQLITE_OK && result.rows.size() == 1, "SELECT returns rows through the future");
+    }
+
+    std::cout << "Check executor without connections reports the open error\n";
+    sqlite3_async_executor failed("missing_directory/async_files.db", 2);
+    verify(failed.get_last_error() == SQLITE_CANTOPEN, "executor fails to open connections");
+    verify(failed.exec("SELECT 1").get() == SQLITE_CANTOPEN, "exec() reports the open error");
+    const auto result = failed.query_as<std::tuple<int>>("SELECT 1").get();
+    verify(result.return_code == SQLITE_CANTOPEN && result.rows.empty(), "query_as() reports the open error");
+}
+
+/// Page cache test, connections share the memory budget while counters are read concurrently;
+/// runs last, as the page cache is replaced after sqlite3_shutdown()
+void page_cache_test()
+{
+    sqlite3_shutdown();
+    sqlite3_page_cache_options options;
+    options.shards = 4;
+    options.global_budget_bytes = 256 * 4400;
+    verify(sqlite3_page_cache::install(options) == SQLITE_OK, "page cache is installed");
+
+    std::cout << "Perform concurrent writes under the page cache budget\n";
+    std::atomic<bool> done{ false };
+    std::thread sampler([&done] {
+        while (!done.load()) {
+            sqlite3_page_cache::get_stats();
+        }
+    });
+    std::vector<std::thread> writers;
+    std::atomic<int> intact{ 0 };
+    for (int i = 0; i < 4; ++i) {
+        writers.emplace_back([i, &intact] {
+            const std::string name = "page_cache_files" + std::to_string(i) + ".db";
+            sqlite3_helper db(name.c_str());
+            db.exec("PRAGMA cache_size = 200");
+            db.exec("DROP TABLE IF EXISTS files");
+            db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY, filename TEXT)");
+            db.exec("CREATE INDEX files_filename ON files(filename)");
+            db.exec("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 20000) "
+                "INSERT INTO files(filename) SELECT hex(randomblob(40)) FROM n");
+            const auto check = db.query_as<std::tuple<std::string>>("PRAGMA integrity_check");
+            if (db.is_valid() && check.size() == 1 && std::get<0>(check[0]) == "ok") {
+                ++intact;
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    done = true;
+    sampler.join();
+    verify(intact == 4, "databases are intact");
+
+    const sqlite3_page_cache_stats stats = sqlite3_page_cache::get_stats();
+    verify(stats.misses > 0 && stats.evictions + stats.steals > 0, "pages are evicted under the budget");
+    verify(stats.pages == 0 && stats.used_bytes == 0, "closed connections release their pages");
+
+    sqlite3_shutdown();
+    verify(sqlite3_page_cache::uninstall() == SQLITE_OK, "page cache is uninstalled");
+}
+
+/// Allocator test, connections on several threads allocate from size-class pools and the bump arena;
+/// runs last, as the allocator is replaced after sqlite3_shutdown()
+void allocator_test()
+{
+    sqlite3_shutdown();
+    verify(sqlite3_allocator::install() == SQLITE_OK, "allocator is installed");
+
+    std::cout << "Perform concurrent inserts with the allocator\n";
+    std::vector<std::thread> writers;
+    std::atomic<int> inserted{ 0 };
+    for (int i = 0; i < 4; ++i) {
+        writers.emplace_back([&inserted] {
+            sqlite3_helper db(":memory:");
+            db.exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT)");
+            for (int row = 0; row < 200; ++row) {
+                // Statement memory of every prepare/step/finalize is bumped from the arena
+                sqlite3_allocator::arena_scope arena;
+                sqlite3_helper::statement insert = db.prepare("INSERT INTO files(filename) VALUES (?)");
+                if (insert.exec("C:/Temp/usernames.txt" + std::to_string(row)) == SQLITE_OK) {
+                    ++inserted;
+                }
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    verify(inserted == 800, "rows are inserted");
+
+    const sqlite3_allocator_stats stats = sqlite3_allocator::get_stats();
+    verify(stats.pool_allocations > 0 && stats.arena_allocations > 0 && stats.frees > 0, "allocations are served by pools and arena");
+
+    std::cout << "Check allocator is kept while SQLite holds its blocks\n";
+    {
+        sqlite3_helper db(":memory:");
+        verify(sqlite3_allocator::uninstall() == SQLITE_BUSY, "uninstall fails while a connection is open");
+    }
+
+    sqlite3_shutdown();
+    verify(sqlite3_allocator::get_stats().bytes_in_use == 0, "all blocks are freed after closing connections");
+    verify(sqlite3_allocator::uninstall() == SQLITE_OK, "allocator is uninstalled");
+}
+
+#ifdef SQLITE3_HELPER_COROUTINES
+/// @brief Coroutine started eagerly, its frame is kept after completion and destroyed by the owner
+struct example_coroutine
+{
+    struct promise_type
+    {
+        example_coroutine get_return_object()
+        {
+            return example_coroutine{ std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+
+        std::suspend_never initial_suspend()
+        {
+            return {};
+        }
+
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {}
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+/// @brief Event loop of the test thread, coroutines are resumed on it instead of worker threads
+class example_event_loop
+{
+public:
+
+    void post(std::coroutine_handle<> handle)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            resumed_.push_back(handle);
+        }
+        posted_.notify_one();
+    }
+
+    /// @brief Resume posted coroutines until the one is done
+    void run_until_done(std::coroutine_handle<> coroutine)
+    {
+        while (!coroutine.done()) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            posted_.wait(lock, [this] { return !resumed_.empty(); });
+            std::coroutine_handle<> handle = resumed_.front();
+            resumed_.pop_front();
+            lock.unlock();
+            handle.resume();
+        }
+    }
+
+    size_t pending() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return resumed_.size();
+    }
+
+private:
+
+    mutable std::mutex mutex_;
+    std::condition_variable posted_;
+    std::deque<std::coroutine_handle<>> resumed_;
+};
+
+example_coroutine read_files(sqlite3_async_executor& executor, example_event_loop& loop, size_t& rows_read, size_t& rows_streamed)
+{
+    const auto scheduler = [&loop](std::coroutine_handle<> handle) { loop.post(handle); };
+    const auto result = co_await executor.query_async<std::tuple<std::string, double>>("SELECT filename, entropy FROM files").via(scheduler);
+    rows_read = result.rows.size();
+
+    sqlite3_row_stream<std::tuple<std::string, double>> stream =
+        executor.query_stream<std::tuple<std::string, double>>(16, 2, "SELECT filename, entropy FROM files");
+    stream.via(scheduler);
+    while (co_await stream.next()) {
+        ++rows_streamed;
+    }
+}
+
+example_coroutine abandon_stream(sqlite3_async_executor& executor, example_event_loop& loop, bool& resumed)
+{
+    // The only row comes after a long computation, the coroutine is destroyed while waiting for it
+    sqlite3_row_stream<std::tuple<sqlite3_int64>> stream = executor.query_stream<std::tuple<sqlite3_int64>>(1, 1,
+        "WITH RECURSIVE counter(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM counter WHERE x < 2000000) SELECT max(x) FROM counter");
+    stream.via([&loop](std::coroutine_handle<> handle) { loop.post(handle); });
+    co_await stream.next();
+    resumed = true;
+}
+
+/// Coroutine test, rows are awaited and streamed on the test thread, abandoned stream does not resume its consumer
+void coroutine_test()
+{
+    sqlite3_async_executor executor("coroutine_files.db", 2);
+    executor.exec("DROP TABLE IF EXISTS files").wait();
+    executor.exec("CREATE TABLE files(id INTEGER PRIMARY KEY AUTOINCREMENT, filename TEXT, entropy REAL)").wait();
+    executor.exec("WITH RECURSIVE counter(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM counter WHERE x < 100) "
+        "INSERT INTO files(filename, entropy) SELECT 'C:/Temp/file' || x || '.txt', x / 10.0 FROM counter").wait();
+
+    std::cout << "Perform SELECT in coroutines\n";
+    example_event_loop loop;
+    size_t rows_read = 0;
+    size_t rows_streamed = 0;
+    example_coroutine reader = read_files(executor, loop, rows_read, rows_streamed);
+    loop.run_until_done(reader.handle);
+    reader.handle.destroy();
+    verify(rows_read == 100 && rows_streamed == 100, "coroutine reads and streams all rows");
+
+    std::cout << "Check destroyed consumer of a stream is not resumed\n";
+    bool resumed = false;
+    {
+        sqlite3_async_executor single_worker("coroutine_files.db", 1);
+        example_coroutine abandoned = abandon_stream(single_worker, loop, resumed);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        verify(!abandoned.handle.done() && loop.pending() == 0, "consumer waits for the first row");
+        abandoned.handle.destroy();
+        // Executor destructor waits for the worker to finish the query
+    }
+    verify(!resumed && loop.pending() == 0, "worker does not resume destroyed consumer");
+}
+#endif
+
+int main()
+{
+    // Perform simple database creation test and error handling
+    simple_test();
+
+    // Perform test with Unicode data converting into UTF-8
+    unicode_test();
+
+    // Perform test with statements compiled once and executed many times
+    prepared_statement_test();
+
+    // Perform test of the connection statement cache
+    statement_cache_test();
+
+    // Perform test of per-statement latency profiling
+    profiler_test();
+
+    // Perform test of memory and cache statistics
+    stats_test();
+
+    // Perform test of online backup
+    backup_test();
+
+#ifdef SQLITE3_HELPER_DESERIALIZE
+    // Perform test of database snapshots
+    snapshot_test();
+#endif
+
+    // Perform test of incremental BLOB I/O
+    blob_stream_test();
+
+    // Perform test of IN-lists bound as containers
+    carray_test();
+
+    // Perform test of batched insertion and its error handling
+    bulk_insert_test();
+
+    // Perform test of connection settings
+    open_options_test();
+
+    // Perform test of retries on a locked database
+    busy_policy_test();
+
+    // Perform test of the reader and writer connection pool
+    pool_test();
+
+    // Perform test of lookaside re-sizing of pool readers
+    lookaside_tuner_test();
+
+    // Perform test of background WAL checkpoints
+    wal_manager_test();
+
+    // Perform test of queries on worker threads
+    async_executor_test();
+
+#ifdef SQLITE3_HELPER_COROUTINES
+    // Perform test of awaitable and streamed queries
+    coroutine_test();
+#endif
+
+    // Perform test of the page cache shared by connections
+    page_cache_test();
+
+    // Perform test of the memory allocator
+    allocator_test();
+
+    return failed_checks == 0 ? 0 : 1;
+}
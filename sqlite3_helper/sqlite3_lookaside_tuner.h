@@ -0,0 +1,196 @@
+#pragma once
+
+#include "sqlite3_helper.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+/// @brief Settings of sqlite3_lookaside_tuner
+struct sqlite3_lookaside_tuner_options
+{
+    /// Configuration of the first warm-up window, SQLite default
+    sqlite3_helper::lookaside_config initial;
+
+    /// Observations (e.g. returned pool leases) in one warm-up window
+    uint32_t warmup_samples = 1000;
+
+    /// Share of allocations missed because slots were too small or all in use, which makes the tuner grow them
+    double miss_threshold = 0.02;
+
+    /// Limits of the recommended configuration
+    int max_slot_size = 4096;
+    int min_slot_count = 16;
+
+    /// Lookaside memory of one connection, slot_size * slot_count
+    sqlite3_int64 max_bytes = 1024 * 1024;
+};
+
+/// @brief Lookaside memory auto-tuner
+/// Accumulates SQLITE_DBSTATUS_LOOKASIDE_HIT/MISS_SIZE/MISS_FULL of connections during a warm-up window,
+/// then recommends the next configuration: larger slots if allocations miss as too large,
+/// more slots if they miss as all slots are in use, fewer slots if most of them are never used.
+/// Every recommendation increments the generation, connections configured with an older generation
+/// are not observed; tuning stops when a window keeps the configuration unchanged.
+/// Thread-safe, observed connections may be used by different threads
+class sqlite3_lookaside_tuner
+{
+public:
+
+    /// @brief Counters of one warm-up window
+    struct window_stats
+    {
+        sqlite3_int64 hits = 0;
+        sqlite3_int64 misses_size = 0;
+        sqlite3_int64 misses_full = 0;
+
+        /// Most slots in use at once by one connection
+        sqlite3_int64 used_highwater = 0;
+    };
+
+    explicit sqlite3_lookaside_tuner(const sqlite3_lookaside_tuner_options& options = sqlite3_lookaside_tuner_options()) :
+        options_(options),
+        config_(options.initial)
+    {
+    }
+
+    sqlite3_lookaside_tuner(const sqlite3_lookaside_tuner&) = delete;
+    sqlite3_lookaside_tuner& operator=(const sqlite3_lookaside_tuner&) = delete;
+
+    /// @brief Add counters of the connection to the window and reset them
+    /// The connection should not be in use by another thread
+    /// @param generation: generation of the connection's lookaside configuration
+    void observe(sqlite3* db, uint32_t generation)
+    {
+        if (stable_.load(std::memory_order_relaxed) || generation != generation_.load(std::memory_order_acquire)) {
+            return;
+        }
+        int current = 0;
+        int hits = 0;
+        int misses_size = 0;
+        int misses_full = 0;
+        int used_highwater = 0;
+        if (sqlite3_db_status(db, SQLITE_DBSTATUS_LOOKASIDE_HIT, &current, &hits, 1) != SQLITE_OK
+            || sqlite3_db_status(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, &current, &misses_size, 1) != SQLITE_OK
+            || sqlite3_db_status(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL, &current, &misses_full, 1) != SQLITE_OK
+            || sqlite3_db_status(db, SQLITE_DBSTATUS_LOOKASIDE_USED, &current, &used_highwater, 1) != SQLITE_OK) {
+            return;
+        }
+        hits_.fetch_add(hits, std::memory_order_relaxed);
+        misses_size_.fetch_add(misses_size, std::memory_order_relaxed);
+        misses_full_.fetch_add(misses_full, std::memory_order_relaxed);
+        sqlite3_int64 highwater = used_highwater_.load(std::memory_order_relaxed);
+        while (highwater < used_highwater
+            && !used_highwater_.compare_exchange_weak(highwater, used_highwater, std::memory_order_relaxed)) {
+        }
+        if (samples_.fetch_add(1, std::memory_order_acq_rel) + 1 == options_.warmup_samples) {
+            finish_window();
+        }
+    }
+
+    /// @brief Generation of the current recommendation, 0 before the first window is over
+    uint32_t get_generation() const
+    {
+        return generation_.load(std::memory_order_acquire);
+    }
+
+    /// @brief Recommended configuration, the initial one before the first window is over
+    sqlite3_helper::lookaside_config get_config() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return config_;
+    }
+
+    /// @brief Configuration and generation read together
+    sqlite3_helper::lookaside_config get_config(uint32_t& generation) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation = generation_.load(std::memory_order_relaxed);
+        return config_;
+    }
+
+    /// @brief Counters of the last finished window
+    window_stats get_last_window() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return last_window_;
+    }
+
+    /// @brief Did the last window keep the configuration unchanged
+    bool is_stable() const
+    {
+        return stable_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Start tuning again from the current configuration, e.g. after the workload has changed
+    void restart()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        reset_window();
+        stable_.store(false, std::memory_order_relaxed);
+    }
+
+private:
+
+    /// @brief Compute the next configuration from the window counters
+    void finish_window()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_window_.hits = hits_.load(std::memory_order_relaxed);
+        last_window_.misses_size = misses_size_.load(std::memory_order_relaxed);
+        last_window_.misses_full = misses_full_.load(std::memory_order_relaxed);
+        last_window_.used_highwater = used_highwater_.load(std::memory_order_relaxed);
+        reset_window();
+
+        const window_stats& window = last_window_;
+        const double total = static_cast<double>(std::max<sqlite3_int64>(1, window.hits + window.misses_size + window.misses_full));
+        sqlite3_helper::lookaside_config next = config_;
+        if (static_cast<double>(window.misses_size) / total > options_.miss_threshold) {
+            next.slot_size = std::min(options_.max_slot_size, next.slot_size * 2) / 8 * 8;
+        }
+        if (static_cast<double>(window.misses_full) / total > options_.miss_threshold) {
+            next.slot_count *= 2;
+        }
+        else if (window.misses_full == 0 && window.used_highwater * 2 < next.slot_count) {
+            // Keep a quarter over the peak
+            next.slot_count = static_cast<int>(window.used_highwater + window.used_highwater / 4);
+        }
+        next.slot_count = std::max(next.slot_count, options_.min_slot_count);
+        if (static_cast<sqlite3_int64>(next.slot_size) * next.slot_count > options_.max_bytes) {
+            next.slot_count = static_cast<int>(options_.max_bytes / std::max(next.slot_size, 1));
+        }
+
+        if (next.slot_size == config_.slot_size && next.slot_count == config_.slot_count) {
+            stable_.store(true, std::memory_order_relaxed);
+            return;
+        }
+        config_ = next;
+        generation_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    void reset_window()
+    {
+        hits_.store(0, std::memory_order_relaxed);
+        misses_size_.store(0, std::memory_order_relaxed);
+        misses_full_.store(0, std::memory_order_relaxed);
+        used_highwater_.store(0, std::memory_order_relaxed);
+        samples_.store(0, std::memory_order_release);
+    }
+
+    sqlite3_lookaside_tuner_options options_;
+
+    /// Guards recommendation and the last window
+    mutable std::mutex mutex_;
+    sqlite3_helper::lookaside_config config_;
+    window_stats last_window_;
+
+    std::atomic<uint32_t> generation_{ 0 };
+    std::atomic<bool> stable_{ false };
+
+    /// Counters of the current window
+    std::atomic<uint32_t> samples_{ 0 };
+    std::atomic<sqlite3_int64> hits_{ 0 };
+    std::atomic<sqlite3_int64> misses_size_{ 0 };
+    std::atomic<sqlite3_int64> misses_full_{ 0 };
+    std::atomic<sqlite3_int64> used_highwater_{ 0 };
+};
@@ -0,0 +1,665 @@
+#pragma once
+
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+// Keep std::min and std::max usable
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/// @brief Settings of sqlite3_page_cache
+struct sqlite3_page_cache_options
+{
+    /// Page frames are carved from slabs of this size, aligned to it if it is a power of two,
+    /// so that the kernel could back them with transparent huge pages
+    size_t slab_bytes = 2 * 1024 * 1024;
+
+    /// madvise(MADV_HUGEPAGE) on every slab, where supported
+    bool huge_pages = true;
+
+    /// Hash shards of every cache, rounded up to a power of two
+    size_t shards = 8;
+
+    /// Memory budget of page frames of all connections, zero for none.
+    /// Over the budget a cache evicts its own unpinned pages first, then pages of other connections,
+    /// so a busy connection could use memory released by idle ones, regardless of their cache_size
+    size_t global_budget_bytes = 0;
+};
+
+/// @brief Page cache counters summed over all caches
+struct sqlite3_page_cache_stats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    /// Pages evicted from the own cache, and taken from caches of other connections over the global budget
+    uint64_t evictions = 0;
+    uint64_t steals = 0;
+
+    /// Pages held by all caches
+    uint64_t pages = 0;
+
+    /// Bytes of page frames held by caches, and reserved in slabs
+    uint64_t used_bytes = 0;
+    uint64_t reserved_bytes = 0;
+    uint64_t slabs = 0;
+};
+
+/// @brief Page cache module installed through SQLITE_CONFIG_PCACHE2
+/// Page frames (page buffer, extra bytes and header) are carved from large contiguous slabs
+/// instead of allocated one by one, which keeps allocator overhead off page cache misses and,
+/// with huge pages, the TLB footprint of a large cache small. Slabs are kept until the process exits.
+/// Every cache has a sharded hash for page lookup and evicts unpinned pages by CLOCK.
+/// Must be installed before sqlite3_initialize(), that is before the first connection is opened,
+/// or after sqlite3_shutdown()
+class sqlite3_page_cache
+{
+public:
+
+    /// @brief Replace SQLite page cache, process-wide
+    /// @return: SQLite error code, SQLITE_MISUSE if SQLite is already initialized
+    static int install(const sqlite3_page_cache_options& options = sqlite3_page_cache_options())
+    {
+        global_state& state = global();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.installed) {
+            return SQLITE_MISUSE;
+        }
+        int return_code = sqlite3_config(SQLITE_CONFIG_GETPCACHE2, &state.previous);
+        if (return_code != SQLITE_OK) {
+            return return_code;
+        }
+        state.options = options;
+        size_t shards = 1;
+        while (shards < options.shards) {
+            shards <<= 1;
+        }
+        state.options.shards = shards;
+
+        static const sqlite3_pcache_methods2 methods = {
+            1,
+            nullptr,
+            &sqlite3_page_cache::init,
+            &sqlite3_page_cache::shutdown,
+            &sqlite3_page_cache::create,
+            &sqlite3_page_cache::cachesize,
+            &sqlite3_page_cache::pagecount,
+            &sqlite3_page_cache::fetch,
+            &sqlite3_page_cache::unpin,
+            &sqlite3_page_cache::rekey,
+            &sqlite3_page_cache::truncate,
+            &sqlite3_page_cache::destroy,
+            &sqlite3_page_cache::shrink
+        };
+        if ((return_code = sqlite3_config(SQLITE_CONFIG_PCACHE2, &methods)) == SQLITE_OK) {
+            state.installed = true;
+        }
+        return return_code;
+    }
+
+    /// @brief Restore the page cache replaced by install(), after sqlite3_shutdown()
+    /// @return: SQLite error code, SQLITE_MISUSE if SQLite is initialized
+    static int uninstall()
+    {
+        global_state& state = global();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.installed) {
+            return SQLITE_MISUSE;
+        }
+        const int return_code = sqlite3_config(SQLITE_CONFIG_PCACHE2, &state.previous);
+        if (return_code == SQLITE_OK) {
+            state.installed = false;
+        }
+        return return_code;
+    }
+
+    /// @brief Counters of live and destroyed caches
+    static sqlite3_page_cache_stats get_stats()
+    {
+        global_state& state = global();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        sqlite3_page_cache_stats result = state.destroyed;
+        for (const cache* owner : state.caches) {
+            for (size_t i = 0; i <= owner->shard_mask; ++i) {
+                // Shard locks are not taken: fetch() holds one while it waits for the global lock in steal()
+                const shard& target = owner->shards[i];
+                result.hits += target.hits.load(std::memory_order_relaxed);
+                result.misses += target.misses.load(std::memory_order_relaxed);
+                result.evictions += target.evictions.load(std::memory_order_relaxed);
+                result.steals += target.steals.load(std::memory_order_relaxed);
+                result.pages += target.pages.load(std::memory_order_relaxed);
+            }
+        }
+        for (const std::unique_ptr<frame_pool>& pool : state.pools) {
+            std::lock_guard<std::mutex> pool_lock(pool->mutex);
+            result.reserved_bytes += pool->slabs * state.options.slab_bytes;
+            result.slabs += pool->slabs;
+        }
+        result.used_bytes = state.used_bytes.load(std::memory_order_relaxed);
+        return result;
+    }
+
+private:
+
+    /// @brief Header of a page frame, placed after the page buffer and extra bytes
+    struct page_frame
+    {
+        /// Must be the first member, SQLite passes it back to unpin/rekey
+        sqlite3_pcache_page page;
+
+        page_frame* next_in_bucket;
+        unsigned key;
+
+        /// Position in the CLOCK ring of the shard
+        size_t clock_slot;
+
+        bool pinned;
+
+        /// CLOCK reference bit, set on every fetch
+        bool referenced;
+    };
+
+    /// @brief Free page frames of one size, carved from slabs
+    struct frame_pool
+    {
+        size_t frame_size = 0;
+        std::mutex mutex;
+        std::vector<page_frame*> free;
+        char* unused = nullptr;
+        size_t unused_bytes = 0;
+        uint64_t slabs = 0;
+    };
+
+    /// @brief Part of the cache guarded by its own lock
+    struct shard
+    {
+        std::mutex mutex;
+        std::vector<page_frame*> buckets;
+
+        /// All pages of the shard in CLOCK order
+        std::vector<page_frame*> clock;
+        size_t hand = 0;
+
+        /// Written under the shard lock, read by get_stats() without it
+        std::atomic<uint64_t> hits{ 0 };
+        std::atomic<uint64_t> misses{ 0 };
+        std::atomic<uint64_t> evictions{ 0 };
+        std::atomic<uint64_t> steals{ 0 };
+        std::atomic<uint64_t> pages{ 0 };
+    };
+
+    /// @brief Cache of one database file of one connection
+    struct cache
+    {
+        size_t page_size = 0;
+        size_t extra_size = 0;
+        bool purgeable = false;
+        frame_pool* pool = nullptr;
+
+        /// Limit of pages per shard, set by cache_size
+        std::atomic<size_t> shard_limit{ 1 };
+
+        std::unique_ptr<shard[]> shards;
+        size_t shard_mask = 0;
+        unsigned shard_bits = 0;
+    };
+
+    /// @brief Process-wide state, intentionally never destroyed as SQLite may use it during exit
+    struct global_state
+    {
+        std::mutex mutex;
+        bool installed = false;
+        sqlite3_page_cache_options options;
+        sqlite3_pcache_methods2 previous = {};
+        std::vector<std::unique_ptr<frame_pool>> pools;
+        std::vector<cache*> caches;
+        sqlite3_page_cache_stats destroyed;
+        std::atomic<size_t> used_bytes{ 0 };
+
+        /// Start of the next steal, so that pages are taken from caches in turn
+        std::atomic<size_t> steal_position{ 0 };
+    };
+
+    static global_state& global()
+    {
+        static global_state* state = new global_state();
+        return *state;
+    }
+
+    static size_t round_up(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    /// @brief Map a slab, aligned to its size for transparent huge pages
+    static char* map_slab(size_t bytes, bool huge_pages)
+    {
+#ifdef _WIN32
+        (void)huge_pages;
+        return static_cast<char*>(VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+        const bool aligned = (bytes & (bytes - 1)) == 0;
+        const size_t mapped_bytes = aligned ? bytes * 2 : bytes;
+        void* mapped = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) {
+            return nullptr;
+        }
+        char* slab = static_cast<char*>(mapped);
+        if (aligned) {
+            // Trim the mapping to an aligned slab
+            const uintptr_t address = reinterpret_cast<uintptr_t>(mapped);
+            const size_t head = static_cast<size_t>(round_up(address, bytes) - address);
+            if (head > 0) {
+                munmap(slab, head);
+            }
+            if (bytes - head > 0) {
+                munmap(slab + head + bytes, bytes - head);
+            }
+            slab += head;
+        }
+#ifdef MADV_HUGEPAGE
+        if (huge_pages) {
+            madvise(slab, bytes, MADV_HUGEPAGE);
+        }
+#else
+        (void)huge_pages;
+#endif
+        return slab;
+#endif
+    }
+
+    static frame_pool* pool_of(size_t frame_size)
+    {
+        global_state& state = global();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (const std::unique_ptr<frame_pool>& pool : state.pools) {
+            if (pool->frame_size == frame_size) {
+                return pool.get();
+            }
+        }
+        state.pools.emplace_back(new frame_pool());
+        state.pools.back()->frame_size = frame_size;
+        return state.pools.back().get();
+    }
+
+    /// @brief Take a free frame, frame header follows page buffer and extra bytes
+    static page_frame* allocate_frame(cache& owner)
+    {
+        frame_pool& pool = *owner.pool;
+        char* memory = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            if (!pool.free.empty()) {
+                page_frame* frame = pool.free.back();
+                pool.free.pop_back();
+                global().used_bytes.fetch_add(pool.frame_size, std::memory_order_relaxed);
+                return frame;
+            }
+            if (pool.unused_bytes < pool.frame_size) {
+                const global_state& state = global();
+                const size_t slab_bytes = std::max(state.options.slab_bytes, pool.frame_size);
+                pool.unused = map_slab(slab_bytes, state.options.huge_pages);
+                pool.unused_bytes = (pool.unused != nullptr) ? slab_bytes : 0;
+                if (pool.unused == nullptr) {
+                    return nullptr;
+                }
+                ++pool.slabs;
+            }
+            memory = pool.unused;
+            pool.unused += pool.frame_size;
+            pool.unused_bytes -= pool.frame_size;
+        }
+        global().used_bytes.fetch_add(pool.frame_size, std::memory_order_relaxed);
+        page_frame* frame = reinterpret_cast<page_frame*>(memory + pool.frame_size - round_up(sizeof(page_frame), 16));
+        frame->page.pBuf = memory;
+        frame->page.pExtra = memory + round_up(owner.page_size, 16);
+        return frame;
+    }
+
+    static void release_frame(frame_pool& pool, page_frame* frame)
+    {
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.free.push_back(frame);
+        }
+        global().used_bytes.fetch_sub(pool.frame_size, std::memory_order_relaxed);
+    }
+
+    /// @brief Increment a shard counter, the only writer holds the shard lock, so no atomic read-modify-write is needed
+    static void increment(std::atomic<uint64_t>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static shard& shard_of(cache& owner, unsigned key)
+    {
+        return owner.shards[key & owner.shard_mask];
+    }
+
+    static page_frame*& bucket_of(const cache& owner, shard& target, unsigned key)
+    {
+        return target.buckets[(key >> owner.shard_bits) & (target.buckets.size() - 1)];
+    }
+
+    static page_frame* find(const cache& owner, shard& target, unsigned key)
+    {
+        if (target.buckets.empty()) {
+            return nullptr;
+        }
+        page_frame* frame = bucket_of(owner, target, key);
+        while (frame != nullptr && frame->key != key) {
+            frame = frame->next_in_bucket;
+        }
+        return frame;
+    }
+
+    static void insert(const cache& owner, shard& target, page_frame* frame)
+    {
+        if (target.clock.size() >= target.buckets.size()) {
+            // Keep load factor at most 1
+            std::vector<page_frame*> buckets(std::max<size_t>(16, target.buckets.size() * 2), nullptr);
+            target.buckets.swap(buckets);
+            for (page_frame* head : buckets) {
+                while (head != nullptr) {
+                    page_frame* next = head->next_in_bucket;
+                    page_frame*& bucket = bucket_of(owner, target, head->key);
+                    head->next_in_bucket = bucket;
+                    bucket = head;
+                    head = next;
+                }
+            }
+        }
+        page_frame*& bucket = bucket_of(owner, target, frame->key);
+        frame->next_in_bucket = bucket;
+        bucket = frame;
+        frame->clock_slot = target.clock.size();
+        target.clock.push_back(frame);
+        target.pages.store(target.clock.size(), std::memory_order_relaxed);
+    }
+
+    static void remove(const cache& owner, shard& target, page_frame* frame)
+    {
+        page_frame** link = &bucket_of(owner, target, frame->key);
+        while (*link != frame) {
+            link = &(*link)->next_in_bucket;
+        }
+        *link = frame->next_in_bucket;
+
+        page_frame* last = target.clock.back();
+        last->clock_slot = frame->clock_slot;
+        target.clock[frame->clock_slot] = last;
+        target.clock.pop_back();
+        target.pages.store(target.clock.size(), std::memory_order_relaxed);
+        if (target.hand >= target.clock.size()) {
+            target.hand = 0;
+        }
+    }
+
+    /// @brief CLOCK: skip pinned pages, give referenced pages a second chance
+    /// @return: removed unpinned page, nullptr if all pages are pinned
+    static page_frame* evict_one(const cache& owner, shard& target)
+    {
+        const size_t limit = target.clock.size() * 2;
+        for (size_t visited = 0; visited < limit; ++visited) {
+            page_frame* frame = target.clock[target.hand];
+            if (!frame->pinned) {
+                if (!frame->referenced) {
+                    remove(owner, target, frame);
+                    return frame;
+                }
+                frame->referenced = false;
+            }
+            target.hand = (target.hand + 1 < target.clock.size()) ? target.hand + 1 : 0;
+        }
+        return nullptr;
+    }
+
+    /// @brief Over the global budget: release an unpinned page of another connection
+    /// Called with the thief shard locked; locks are always taken in the order shard, global, frame pool,
+    /// and shards of other caches only with try_lock, as their owners may be waiting for the global lock here
+    static bool steal(cache& thief, shard& thief_shard)
+    {
+        global_state& state = global();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        const size_t count = state.caches.size();
+        const size_t start = state.steal_position.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i) {
+            cache& victim = *state.caches[(start + i) % count];
+            if (&victim == &thief || victim.pool != thief.pool || !victim.purgeable) {
+                continue;
+            }
+            for (size_t s = 0; s <= victim.shard_mask; ++s) {
+                shard& target = victim.shards[s];
+                std::unique_lock<std::mutex> victim_lock(target.mutex, std::try_to_lock);
+                if (!victim_lock.owns_lock()) {
+                    continue;
+                }
+                page_frame* frame = evict_one(victim, target);
+                if (frame != nullptr) {
+                    release_frame(*victim.pool, frame);
+                    increment(thief_shard.steals);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static int init(void*)
+    {
+        return SQLITE_OK;
+    }
+
+    static void shutdown(void*)
+    {
+    }
+
+    /// @brief sqlite3_pcache_methods2::xCreate
+    static sqlite3_pcache* create(int page_size, int extra_size, int purgeable)
+    {
+        const sqlite3_page_cache_options& options = global().options;
+        cache* owner = new cache();
+        owner->page_size = static_cast<size_t>(page_size);
+        owner->extra_size = static_cast<size_t>(extra_size);
+        owner->purgeable = purgeable != 0;
+        owner->shards.reset(new shard[options.shards]);
+        owner->shard_mask = options.shards - 1;
+        while ((size_t(1) << owner->shard_bits) < options.shards) {
+            ++owner->shard_bits;
+        }
+        owner->pool = pool_of(round_up(owner->page_size, 16) + round_up(owner->extra_size, 16) + round_up(sizeof(page_frame), 16));
+
+        global_state& state = global();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.caches.push_back(owner);
+        return reinterpret_cast<sqlite3_pcache*>(owner);
+    }
+
+    /// @brief sqlite3_pcache_methods2::xCachesize
+    static void cachesize(sqlite3_pcache* handle, int pages)
+    {
+        cache& owner = *reinterpret_cast<cache*>(handle);
+        const size_t shard_count = owner.shard_mask + 1;
+        const size_t total = static_cast<size_t>(std::max(pages, 1));
+        owner.shard_limit.store((total + shard_count - 1) / shard_count, std::memory_order_relaxed);
+    }
+
+    /// @brief sqlite3_pcache_methods2::xPagecount
+    static int pagecount(sqlite3_pcache* handle)
+    {
+        cache& owner = *reinterpret_cast<cache*>(handle);
+        size_t pages = 0;
+        for (size_t i = 0; i <= owner.shard_mask; ++i) {
+            std::lock_guard<std::mutex> lock(owner.shards[i].mutex);
+            pages += owner.shards[i].clock.size();
+        }
+        return static_cast<int>(pages);
+    }
+
+    /// @brief sqlite3_pcache_methods2::xFetch
+    /// @param create: 0 - lookup only, 1 - create if no pinned page has to be kept over the limit,
+    /// 2 - create even over the limit
+    static sqlite3_pcache_page* fetch(sqlite3_pcache* handle, unsigned key, int create)
+    {
+        cache& owner = *reinterpret_cast<cache*>(handle);
+        shard& target = shard_of(owner, key);
+        std::lock_guard<std::mutex> lock(target.mutex);
+        page_frame* frame = find(owner, target, key);
+        if (frame != nullptr) {
+            increment(target.hits);
+            frame->pinned = true;
+            frame->referenced = true;
+            return &frame->page;
+        }
+        increment(target.misses);
+        if (create == 0) {
+            return nullptr;
+        }
+
+        if (owner.purgeable) {
+            const global_state& state = global();
+            const size_t budget = state.options.global_budget_bytes;
+            const bool over_limit = target.clock.size() >= owner.shard_limit.load(std::memory_order_relaxed);
+            const bool over_budget = budget != 0
+                && state.used_bytes.load(std::memory_order_relaxed) + owner.pool->frame_size > budget;
+            if (over_limit || over_budget) {
+                frame = evict_one(owner, target);
+                if (frame != nullptr) {
+                    increment(target.evictions);
+                }
+                else if (create == 1 && over_limit) {
+                    // SQLite spills dirty pages and asks again with create == 2
+                    return nullptr;
+                }
+                else if (over_budget && !steal(owner, target) && create == 1) {
+                    // Otherwise a frame of another connection is back in the pool
+                    return nullptr;
+                }
+            }
+        }
+        if (frame == nullptr && (frame = allocate_frame(owner)) == nullptr) {
+            return nullptr;
+        }
+
+        frame->key = key;
+        frame->pinned = true;
+        frame->referenced = true;
+        // pcache.c checks the first pointer of extra bytes to find uninitialized pages
+        std::memset(frame->page.pExtra, 0, std::min(owner.extra_size, sizeof(void*)));
+        insert(owner, target, frame);
+        return &frame->page;
+    }
+
+    /// @brief sqlite3_pcache_methods2::xUnpin
+    static void unpin(sqlite3_pcache* handle, sqlite3_pcache_page* page, int discard)
+    {
+        cache& owner = *reinterpret_cast<cache*>(handle);
+        page_frame* frame = reinterpret_cast<page_frame*>(page);
+        shard& target = shard_of(owner, frame->key);
+        std::lock_guard<std::mutex> lock(target.mutex);
+        frame->pinned = false;
+        if (discard != 0 || (owner.purgeable && target.clock.size() > owner.shard_limit.load(std::memory_order_relaxed))) {
+            remove(owner, target, frame);
+            release_frame(*owner.pool, frame);
+        }
+    }
+
+    /// @brief sqlite3_pcache_methods2::xRekey
+    static void rekey(sqlite3_pcache* handle, sqlite3_pcache_page* page, unsigned old_key, unsigned new_key)
+    {
+        cache& owner = *reinterpret_cast<cache*>(handle);
+        page_frame* frame = reinterpret_cast<page_frame*>(page);
+        shard& from = shard_of(owner, old_key);
+        shard& to = shard_of(owner, new_key);
+        std::unique_lock<std::mutex> first(&from < &to ? from.mutex : to.mutex);
+        std::unique_lock<std::mutex> second;
+        if (&from != &to) {
+            second = std::unique_lock<std::mutex>(&from < &to ? to.mutex : from.mutex);
+        }
+
+        // Page previously cached under the new key is guaranteed to be unpinned
+        page_frame* previous = find(owner, to, new_key);
+        if (previous != nullptr) {
+            remove(owner, to, previous);
+            release_frame(*owner.pool, previous);
+        }
+        remove(owner, from, frame);
+        frame->key = new_key;
+        insert(owner, to, frame);
+    }
+
+    /// @brief sqlite3_pcache_methods2::xTruncate, discard pages with key >= limit
+    static void truncate(sqlite3_pcache* handle, unsigned limit)
+    {
+        cache& owner = *reinterpret_cast<cache*>(handle);
+        for (size_t i = 0; i <= owner.shard_mask; ++i) {
+            shard& target = owner.shards[i];
+            std::lock_guard<std::mutex> lock(target.mutex);
+            for (size_t slot = target.clock.size(); slot > 0; --slot) {
+                page_frame* frame = target.clock[slot - 1];
+                if (frame->key >= limit) {
+                    remove(owner, target, frame);
+                    release_frame(*owner.pool, frame);
+                }
+            }
+        }
+    }
+
+    /// @brief sqlite3_pcache_methods2::xDestroy
+    static void destroy(sqlite3_pcache* handle)
+    {
+        cache* owner = reinterpret_cast<cache*>(handle);
+        global_state& state = global();
+        {
+            // Stealing threads hold the global lock, the cache is not reachable after this
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.caches.erase(std::remove(state.caches.begin(), state.caches.end(), owner), state.caches.end());
+            for (size_t i = 0; i <= owner->shard_mask; ++i) {
+                state.destroyed.hits += owner->shards[i].hits.load(std::memory_order_relaxed);
+                state.destroyed.misses += owner->shards[i].misses.load(std::memory_order_relaxed);
+                state.destroyed.evictions += owner->shards[i].evictions.load(std::memory_order_relaxed);
+                state.destroyed.steals += owner->shards[i].steals.load(std::memory_order_relaxed);
+            }
+        }
+        for (size_t i = 0; i <= owner->shard_mask; ++i) {
+            for (page_frame* frame : owner->shards[i].clock) {
+                release_frame(*owner->pool, frame);
+            }
+        }
+        delete owner;
+    }
+
+    /// @brief sqlite3_pcache_methods2::xShrink, release all unpinned pages
+    static void shrink(sqlite3_pcache* handle)
+    {
+        cache& owner = *reinterpret_cast<cache*>(handle);
+        for (size_t i = 0; i <= owner.shard_mask; ++i) {
+            shard& target = owner.shards[i];
+            std::lock_guard<std::mutex> lock(target.mutex);
+            for (size_t slot = target.clock.size(); slot > 0; --slot) {
+                page_frame* frame = target.clock[slot - 1];
+                if (!frame->pinned) {
+                    remove(owner, target, frame);
+                    release_frame(*owner.pool, frame);
+                }
+            }
+        }
+    }
+};
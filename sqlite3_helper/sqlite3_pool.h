@@ -0,0 +1,389 @@
+#pragma once
+
+#include "sqlite3_helper.h"
+#include "sqlite3_lookaside_tuner.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Pool of read-only connections and one dedicated writer connection to the same database
+/// Database is switched into WAL mode, so readers do not block each other nor the writer.
+/// Connections are opened with SQLITE_OPEN_NOMUTEX, the pool guarantees every connection
+/// is used by one thread at a time. Readers are handed out through a lock-free free list,
+/// writer is guarded by a mutex. Requires SQLite built in multi-thread or serialized mode
+/// and a file database: the pool fails with SQLITE_ERROR if WAL could not be enabled
+/// (in-memory databases, filesystems without shared memory support).
+/// As sqlite3_helper, it does not throw exceptions, check get_last_error() after construction
+class sqlite3_pool
+{
+public:
+
+    /// @brief RAII lease of a pool connection, returns it to the pool on destruction
+    class reader_lease
+    {
+    public:
+
+        /// @brief Empty lease, no connection was available
+        reader_lease()
+        {}
+
+        ~reader_lease()
+        {
+            release();
+        }
+
+        reader_lease(const reader_lease&) = delete;
+        reader_lease& operator=(const reader_lease&) = delete;
+
+        reader_lease(reader_lease&& rhs) :
+            pool_(rhs.pool_),
+            index_(rhs.index_)
+        {
+            rhs.pool_ = nullptr;
+        }
+
+        reader_lease& operator=(reader_lease&& rhs)
+        {
+            if (this != &rhs) {
+                release();
+                pool_ = rhs.pool_;
+                index_ = rhs.index_;
+                rhs.pool_ = nullptr;
+            }
+            return *this;
+        }
+
+        /// @brief Return connection to the pool before destruction
+        void release()
+        {
+            if (pool_ != nullptr) {
+                pool_->return_reader(index_);
+                pool_ = nullptr;
+            }
+        }
+
+        /// @brief Does lease hold a connection
+        operator bool() const
+        {
+            return pool_ != nullptr;
+        }
+
+        sqlite3_helper& operator*() const
+        {
+            return pool_->readers_[index_];
+        }
+
+        sqlite3_helper* operator->() const
+        {
+            return &pool_->readers_[index_];
+        }
+
+    private:
+
+        friend class sqlite3_pool;
+
+        reader_lease(sqlite3_pool* pool, uint32_t index) :
+            pool_(pool),
+            index_(index)
+        {
+        }
+
+        /// Owning pool, nullptr for empty lease
+        sqlite3_pool* pool_ = nullptr;
+
+        /// Reader connection index
+        uint32_t index_ = 0;
+    };
+
+    /// @brief RAII lease of the writer connection, holds writer lock until destruction
+    class writer_lease
+    {
+    public:
+
+        /// @brief Empty lease, writer was busy
+        writer_lease()
+        {}
+
+        writer_lease(const writer_lease&) = delete;
+        writer_lease& operator=(const writer_lease&) = delete;
+
+        writer_lease(writer_lease&& rhs) :
+            writer_(rhs.writer_),
+            lock_(std::move(rhs.lock_))
+        {
+            rhs.writer_ = nullptr;
+        }
+
+        writer_lease& operator=(writer_lease&& rhs)
+        {
+            if (this != &rhs) {
+                release();
+                writer_ = rhs.writer_;
+                lock_ = std::move(rhs.lock_);
+                rhs.writer_ = nullptr;
+            }
+            return *this;
+        }
+
+        /// @brief Return connection to the pool before destruction
+        void release()
+        {
+            if (lock_.owns_lock()) {
+                lock_.unlock();
+            }
+            writer_ = nullptr;
+        }
+
+        /// @brief Does lease hold a connection
+        operator bool() const
+        {
+            return writer_ != nullptr;
+        }
+
+        sqlite3_helper& operator*() const
+        {
+            return *writer_;
+        }
+
+        sqlite3_helper* operator->() const
+        {
+            return writer_;
+        }
+
+    private:
+
+        friend class sqlite3_pool;
+
+        writer_lease(sqlite3_helper* writer, std::unique_lock<std::mutex>&& lock) :
+            writer_(writer),
+            lock_(std::move(lock))
+        {
+        }
+
+        /// Writer connection, nullptr for empty lease
+        sqlite3_helper* writer_ = nullptr;
+
+        /// Writer lock
+        std::unique_lock<std::mutex> lock_;
+    };
+
+    /// @brief Open writer connection (creating the database if needed), switch it to WAL mode
+    /// and open read-only connections
+    /// @param reader_count: number of read-only connections, hardware concurrency by default
+    /// @param options: connection settings, the pool overrides open flags (keeping only SQLITE_OPEN_URI)
+    /// and journal mode; readers ignore page_size
+    /// @param lookaside_tuner: not owned, should outlive the pool; readers are opened with its recommended
+    /// lookaside instead of options.lookaside, observed on every return to the pool, and re-sized on return
+    /// once a newer recommendation is available (dropping their cached statements)
+    explicit sqlite3_pool(const char* database_name, size_t reader_count = 0,
+        const sqlite3_helper::open_options& options = sqlite3_helper::open_options(),
+        sqlite3_lookaside_tuner* lookaside_tuner = nullptr) :
+        lookaside_tuner_(lookaside_tuner)
+    {
+        const int uri_flag = options.flags & SQLITE_OPEN_URI;
+        sqlite3_helper::open_options writer_options = options;
+        writer_options.flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | uri_flag;
+        writer_options.journal_mode = "WAL";
+        if ((current_return_code_ = writer_.open(database_name, writer_options)) != SQLITE_OK) {
+            return;
+        }
+        // Readers would block the writer and each other without WAL
+        if (writer_.get_journal_mode() != "wal") {
+            current_return_code_ = SQLITE_ERROR;
+            return;
+        }
+
+        sqlite3_helper::open_options reader_options = options;
+        reader_options.flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX | uri_flag;
+        reader_options.journal_mode = nullptr;
+        reader_options.page_size.reset();
+        uint32_t lookaside_generation = 0;
+        if (lookaside_tuner_ != nullptr) {
+            reader_options.lookaside = lookaside_tuner_->get_config(lookaside_generation);
+        }
+
+        if (reader_count == 0) {
+            reader_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        readers_.reserve(reader_count);
+        next_.reset(new std::atomic<uint32_t>[reader_count]);
+        lookaside_generations_.assign(reader_count, lookaside_generation);
+        for (size_t i = 0; i < reader_count; ++i) {
+            readers_.emplace_back(database_name, reader_options);
+            if ((current_return_code_ = readers_.back().get_last_error()) != SQLITE_OK) {
+                return;
+            }
+            push_reader(static_cast<uint32_t>(i));
+        }
+    }
+
+    sqlite3_pool(const sqlite3_pool&) = delete;
+    sqlite3_pool& operator=(const sqlite3_pool&) = delete;
+
+    /// @brief Take free reader connection without waiting
+    /// @return: empty lease if all readers are in use
+    reader_lease try_acquire_reader()
+    {
+        const uint32_t index = pop_reader();
+        return (index == empty_list) ? reader_lease() : reader_lease(this, index);
+    }
+
+    /// @brief Take free reader connection, block until one is returned if all are in use
+    /// Free reader is taken without locking, the mutex is used only to sleep when there is none
+    /// @return: empty lease only if the pool has no readers
+    reader_lease acquire_reader()
+    {
+        if (readers_.empty()) {
+            return reader_lease();
+        }
+        uint32_t index = pop_reader();
+        if (index == empty_list) {
+            std::unique_lock<std::mutex> lock(waiters_mutex_);
+            waiters_.fetch_add(1, std::memory_order_relaxed);
+            // Pairs with the fence in return_reader(): either the waiter sees the returned reader,
+            // or the returning thread sees the waiter and notifies it
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            reader_returned_.wait(lock, [this, &index] { return (index = pop_reader()) != empty_list; });
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return reader_lease(this, index);
+    }
+
+    /// @brief Take writer connection without waiting
+    /// @return: empty lease if the writer is in use
+    writer_lease try_acquire_writer()
+    {
+        std::unique_lock<std::mutex> lock(writer_mutex_, std::try_to_lock);
+        return lock.owns_lock() ? writer_lease(&writer_, std::move(lock)) : writer_lease();
+    }
+
+    /// @brief Take writer connection, wait until it is available
+    writer_lease acquire_writer()
+    {
+        std::unique_lock<std::mutex> lock(writer_mutex_);
+        return writer_lease(&writer_, std::move(lock));
+    }
+
+    /// @brief Number of read-only connections
+    size_t reader_count() const
+    {
+        return readers_.size();
+    }
+
+    /// @brief Are all connections opened successfully
+    operator bool() const
+    {
+        return is_valid();
+    }
+
+    /// @brief Are all connections opened successfully
+    bool is_valid() const
+    {
+        return current_return_code_ == SQLITE_OK;
+    }
+
+    /// @brief Return error code of opening connections
+    int get_last_error() const
+    {
+        return current_return_code_;
+    }
+
+    /// @brief Return last error message based on error code
+    const char* get_last_error_message() const
+    {
+        return sqlite3_errstr(current_return_code_);
+    }
+
+private:
+
+    /// Free list terminator
+    static constexpr uint32_t empty_list = 0xFFFFFFFFu;
+
+    /// @brief Treiber stack pop, head is tagged with a modification counter against ABA
+    uint32_t pop_reader()
+    {
+        uint64_t head = free_head_.load(std::memory_order_acquire);
+        for (;;) {
+            const uint32_t index = static_cast<uint32_t>(head);
+            if (index == empty_list) {
+                return empty_list;
+            }
+            const uint32_t next = next_[index].load(std::memory_order_relaxed);
+            const uint64_t new_head = (((head >> 32) + 1) << 32) | next;
+            if (free_head_.compare_exchange_weak(head, new_head, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return index;
+            }
+        }
+    }
+
+    /// @brief Feed the lookaside tuner and apply its recommendation, then put the reader back to the free list
+    void return_reader(uint32_t index)
+    {
+        if (lookaside_tuner_ != nullptr) {
+            sqlite3_helper& reader = readers_[index];
+            uint32_t& generation = lookaside_generations_[index];
+            lookaside_tuner_->observe(reader.handle(), generation);
+            if (generation != lookaside_tuner_->get_generation()) {
+                uint32_t latest = 0;
+                const sqlite3_helper::lookaside_config config = lookaside_tuner_->get_config(latest);
+                reader.clear_statement_cache();
+                // SQLITE_BUSY if the caller keeps own statements, try again on the next return;
+                // the reader's error state is left as is, so the next lease holder does not see it
+                if (sqlite3_helper::set_lookaside(reader.handle(), config) == SQLITE_OK) {
+                    generation = latest;
+                }
+            }
+        }
+        push_reader(index);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) != 0) {
+            std::lock_guard<std::mutex> lock(waiters_mutex_);
+            reader_returned_.notify_one();
+        }
+    }
+
+    /// @brief Treiber stack push
+    void push_reader(uint32_t index)
+    {
+        uint64_t head = free_head_.load(std::memory_order_relaxed);
+        uint64_t new_head = 0;
+        do {
+            next_[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            new_head = (((head >> 32) + 1) << 32) | index;
+        } while (!free_head_.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /// Writer connection, opened first to create the database and enable WAL
+    sqlite3_helper writer_;
+
+    /// Only one writer lease at a time
+    std::mutex writer_mutex_;
+
+    /// Read-only connections
+    std::vector<sqlite3_helper> readers_;
+
+    /// Free list links, next_[i] is the reader following reader i
+    std::unique_ptr<std::atomic<uint32_t>[]> next_;
+
+    /// Free list head: modification counter in high 32 bits, reader index in low 32 bits
+    std::atomic<uint64_t> free_head_{ empty_list };
+
+    /// Threads sleeping in acquire_reader() until a reader is returned
+    std::mutex waiters_mutex_;
+    std::condition_variable reader_returned_;
+    std::atomic<uint32_t> waiters_{ 0 };
+
+    /// Lookaside tuner, not owned, nullptr if not used
+    sqlite3_lookaside_tuner* lookaside_tuner_ = nullptr;
+
+    /// Generation of the lookaside configuration of every reader, written only by the lease holder
+    std::vector<uint32_t> lookaside_generations_;
+
+    /// Error code of opening connections
+    int current_return_code_ = SQLITE_OK;
+};
@@ -0,0 +1,710 @@
+#pragma once
+
+#include "sqlite3_helper.h"
+#include "sqlite3_fingerprint.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief HDR-style latency histogram: log-linear buckets, 16 per power of two,
+/// so any recorded value is reported with ~6% precision from nanoseconds up to hours.
+/// Recording is a few relaxed atomic increments, safe from any thread without locks
+class sqlite3_latency_histogram
+{
+public:
+
+    /// Sub-buckets per power of two
+    static constexpr unsigned sub_bucket_bits = 4;
+    static constexpr uint64_t sub_bucket_count = uint64_t(1) << sub_bucket_bits;
+
+    /// Values above 2^47 ns (~39 hours) are counted in the last bucket
+    static constexpr unsigned max_magnitude = 47;
+    static constexpr size_t bucket_count = (max_magnitude - sub_bucket_bits + 2) * sub_bucket_count;
+
+    void record(uint64_t nanoseconds)
+    {
+        counts_[bucket_index(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        total_count_.fetch_add(1, std::memory_order_relaxed);
+        total_nanoseconds_.fetch_add(nanoseconds, std::memory_order_relaxed);
+        uint64_t max = max_nanoseconds_.load(std::memory_order_relaxed);
+        while (nanoseconds > max && !max_nanoseconds_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const
+    {
+        return total_count_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t total() const
+    {
+        return total_nanoseconds_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t max() const
+    {
+        return max_nanoseconds_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Values at the given fractions (0.5 for median), in a single pass over the buckets
+    /// Concurrent recording may skew the result by the values recorded during the call
+    /// @param fractions: sorted ascending
+    std::vector<uint64_t> percentiles(const std::vector<double>& fractions) const
+    {
+        std::vector<uint64_t> counts(bucket_count);
+        uint64_t total = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            counts[i] = counts_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+
+        std::vector<uint64_t> values(fractions.size(), 0);
+        if (total == 0) {
+            return values;
+        }
+        const uint64_t max_value = max();
+        uint64_t seen = 0;
+        size_t bucket = 0;
+        for (size_t i = 0; i < fractions.size(); ++i) {
+            const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fractions[i] * static_cast<double>(total))));
+            while (bucket < bucket_count && seen + counts[bucket] < rank) {
+                seen += counts[bucket++];
+            }
+            values[i] = std::min(bucket_upper_bound(std::min(bucket, bucket_count - 1)), max_value);
+        }
+        return values;
+    }
+
+    void reset()
+    {
+        for (std::atomic<uint64_t>& bucket : counts_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        total_count_.store(0, std::memory_order_relaxed);
+        total_nanoseconds_.store(0, std::memory_order_relaxed);
+        max_nanoseconds_.store(0, std::memory_order_relaxed);
+    }
+
+    static size_t bucket_index(uint64_t value)
+    {
+        if (value < sub_bucket_count) {
+            return static_cast<size_t>(value);
+        }
+        const unsigned magnitude = floor_log2(value);
+        if (magnitude > max_magnitude) {
+            return bucket_count - 1;
+        }
+        const uint64_t sub_bucket = (value >> (magnitude - sub_bucket_bits)) & (sub_bucket_count - 1);
+        return static_cast<size_t>((magnitude - sub_bucket_bits + 1) * sub_bucket_count + sub_bucket);
+    }
+
+    /// @brief Largest value counted in the bucket
+    static uint64_t bucket_upper_bound(size_t index)
+    {
+        if (index < sub_bucket_count) {
+            return index;
+        }
+        const unsigned magnitude = static_cast<unsigned>(index / sub_bucket_count) + sub_bucket_bits - 1;
+        const uint64_t sub_bucket = index % sub_bucket_count;
+        const unsigned shift = magnitude - sub_bucket_bits;
+        return ((sub_bucket_count + sub_bucket) << shift) + ((uint64_t(1) << shift) - 1);
+    }
+
+private:
+
+    static unsigned floor_log2(uint64_t value)
+    {
+        unsigned result = 0;
+        for (unsigned shift = 32; shift > 0; shift /= 2) {
+            if (value >= (uint64_t(1) << shift)) {
+                value >>= shift;
+                result += shift;
+            }
+        }
+        return result;
+    }
+
+    std::atomic<uint64_t> counts_[bucket_count] = {};
+    std::atomic<uint64_t> total_count_{ 0 };
+    std::atomic<uint64_t> total_nanoseconds_{ 0 };
+    std::atomic<uint64_t> max_nanoseconds_{ 0 };
+};
+
+/// @brief Latency and work summary of one statement fingerprint
+struct sqlite3_latency_snapshot
+{
+    /// SQL fingerprint, see sqlite3_sql_fingerprint
+    std::string sql;
+
+    uint64_t count = 0;
+    std::chrono::nanoseconds total{ 0 };
+    std::chrono::nanoseconds p50{ 0 };
+    std::chrono::nanoseconds p99{ 0 };
+    std::chrono::nanoseconds p999{ 0 };
+    std::chrono::nanoseconds max{ 0 };
+
+    /// Rows returned, counted only with sqlite3_profiler_options::count_rows
+    uint64_t rows = 0;
+
+    /// Sums of sqlite3_stmt_status() counters: SQLITE_STMTSTATUS_FULLSCAN_STEP, SORT, AUTOINDEX and VM_STEP
+    uint64_t fullscan_steps = 0;
+    uint64_t sorts = 0;
+    uint64_t autoindexes = 0;
+    uint64_t vm_steps = 0;
+};
+
+/// @brief Order of sqlite3_profiler::report()
+enum class sqlite3_profile_order
+{
+    total_time,
+    calls,
+    rows,
+    fullscan_steps,
+    vm_steps
+};
+
+/// @brief Settings of sqlite3_profiler
+struct sqlite3_profiler_options
+{
+    /// Statements running longer are passed to slow_query_log, zero disables the log
+    std::chrono::nanoseconds slow_query_threshold{ 0 };
+
+    /// Receives SQL with bound parameters expanded and its run time;
+    /// called on the thread that ran the statement. Empty function writes to stderr
+    std::function<void(const char* sql, std::chrono::nanoseconds elapsed)> slow_query_log;
+
+    /// Distinct fingerprints tracked; the rest are counted under "<other>"
+    size_t max_statements = 1024;
+
+    /// Count returned rows through SQLITE_TRACE_ROW, a callback per row, so it is off by default
+    bool count_rows = false;
+};
+
+/// @brief Per-statement latency profiler
+/// Installs sqlite3_trace_v2() with SQLITE_TRACE_PROFILE | SQLITE_TRACE_STMT and records
+/// the run time of every statement into a histogram keyed by SQL fingerprint, so statements
+/// built from one template with different inline literals are aggregated together.
+/// Run time is measured from the first step (STMT event) to the reset or completion (PROFILE event)
+/// with steady_clock, as time reported by SQLite comes from the VFS clock of millisecond resolution.
+/// Along with the time, sqlite3_stmt_status() counters of every run are summed; they are reset after each run.
+/// Lookup of the histogram is lock-free: an open-addressing table indexed by the hash of the fingerprint,
+/// built in a thread-local buffer without allocation, and the counters found for a statement are
+/// cached per thread by its sqlite3_stmt*, so a re-run prepared statement skips the fingerprint altogether
+/// and the profiler may stay on under production load.
+/// Connection has a single trace callback, so a profiler replaces any other trace.
+/// The helper should outlive the profiler. As sqlite3_helper, it does not throw exceptions
+class sqlite3_profiler
+{
+public:
+
+    explicit sqlite3_profiler(sqlite3_helper& db, const sqlite3_profiler_options& options = sqlite3_profiler_options()) :
+        db_(db),
+        options_(options),
+        id_(next_id()),
+        overflow_("<other>")
+    {
+        size_t capacity = 16;
+        while (capacity < options_.max_statements * 2) {
+            capacity <<= 1;
+        }
+        mask_ = capacity - 1;
+        slots_.reset(new slot[capacity]);
+
+        const unsigned events = SQLITE_TRACE_PROFILE | SQLITE_TRACE_STMT | (options_.count_rows ? SQLITE_TRACE_ROW : 0);
+        current_return_code_ = sqlite3_trace_v2(db_.handle(), events, &sqlite3_profiler::trace_callback, this);
+    }
+
+    /// @brief Remove the trace callback
+    ~sqlite3_profiler()
+    {
+        if (current_return_code_ == SQLITE_OK && db_.handle() != nullptr) {
+            sqlite3_trace_v2(db_.handle(), 0, nullptr, nullptr);
+        }
+        for (size_t i = 0; i <= mask_; ++i) {
+            delete slots_[i].entry.load(std::memory_order_acquire);
+        }
+    }
+
+    sqlite3_profiler(const sqlite3_profiler&) = delete;
+    sqlite3_profiler& operator=(const sqlite3_profiler&) = delete;
+
+    /// @brief Summary of every fingerprint, the most time-consuming first
+    std::vector<sqlite3_latency_snapshot> get_snapshot() const
+    {
+        std::vector<sqlite3_latency_snapshot> result;
+        for (size_t i = 0; i <= mask_; ++i) {
+            const statement_entry* entry = slots_[i].entry.load(std::memory_order_acquire);
+            if (entry != nullptr && entry->histogram.count() > 0) {
+                result.push_back(make_snapshot(*entry));
+            }
+        }
+        if (overflow_.histogram.count() > 0) {
+            result.push_back(make_snapshot(overflow_));
+        }
+        std::sort(result.begin(), result.end(), [](const sqlite3_latency_snapshot& lhs, const sqlite3_latency_snapshot& rhs) {
+            return lhs.total > rhs.total;
+        });
+        return result;
+    }
+
+    /// @brief Summary of the fingerprint of sql, count is zero if it did not run
+    sqlite3_latency_snapshot get_snapshot(const char* sql) const
+    {
+        const std::string fingerprint = sqlite3_sql_fingerprint::make(sql);
+        const statement_entry* entry = find(fingerprint, fingerprint_hash(fingerprint));
+        if (entry == nullptr) {
+            sqlite3_latency_snapshot empty;
+            empty.sql = fingerprint;
+            return empty;
+        }
+        return make_snapshot(*entry);
+    }
+
+    /// @brief Text table of the top fingerprints, for dumping into a log on demand
+    /// @param top: number of fingerprints, zero for all
+    std::string report(size_t top = 20, sqlite3_profile_order order = sqlite3_profile_order::total_time) const
+    {
+        std::vector<sqlite3_latency_snapshot> snapshot = get_snapshot();
+        std::stable_sort(snapshot.begin(), snapshot.end(), [order](const sqlite3_latency_snapshot& lhs, const sqlite3_latency_snapshot& rhs) {
+            return order_key(lhs, order) > order_key(rhs, order);
+        });
+        if (top != 0 && snapshot.size() > top) {
+            snapshot.resize(top);
+        }
+
+        std::string result;
+        char line[256];
+        std::snprintf(line, sizeof(line), "%10s %12s %10s %10s %12s %12s %8s %8s %14s  %s\n",
+            "calls", "total ms", "mean us", "p99 us", "rows", "fullscan", "sort", "autoidx", "vm steps", "fingerprint");
+        result += line;
+        for (const sqlite3_latency_snapshot& statement : snapshot) {
+            const double total_ms = static_cast<double>(statement.total.count()) / 1e6;
+            const double mean_us = static_cast<double>(statement.total.count()) / 1e3 / static_cast<double>(statement.count);
+            std::snprintf(line, sizeof(line), "%10llu %12.3f %10.1f %10.1f %12llu %12llu %8llu %8llu %14llu  ",
+                static_cast<unsigned long long>(statement.count), total_ms, mean_us,
+                static_cast<double>(statement.p99.count()) / 1e3,
+                static_cast<unsigned long long>(statement.rows),
+                static_cast<unsigned long long>(statement.fullscan_steps),
+                static_cast<unsigned long long>(statement.sorts),
+                static_cast<unsigned long long>(statement.autoindexes),
+                static_cast<unsigned long long>(statement.vm_steps));
+            result += line;
+            result += statement.sql;
+            result += '\n';
+        }
+        return result;
+    }
+
+    /// @brief Zero all counters, fingerprints stay registered
+    void reset()
+    {
+        for (size_t i = 0; i <= mask_; ++i) {
+            statement_entry* entry = slots_[i].entry.load(std::memory_order_acquire);
+            if (entry != nullptr) {
+                entry->reset();
+            }
+        }
+        overflow_.reset();
+        statements_started_.store(0, std::memory_order_relaxed);
+        slow_queries_.store(0, std::memory_order_relaxed);
+    }
+
+    /// @brief Statements started since creation or reset(), including ones not finished yet
+    uint64_t get_statements_started() const
+    {
+        return statements_started_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Statements slower than the threshold since creation or reset()
+    uint64_t get_slow_queries() const
+    {
+        return slow_queries_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Is the trace callback installed
+    operator bool() const
+    {
+        return is_valid();
+    }
+
+    /// @brief Is the trace callback installed
+    bool is_valid() const
+    {
+        return current_return_code_ == SQLITE_OK;
+    }
+
+    /// @brief Return error code of installing the trace callback
+    int get_last_error() const
+    {
+        return current_return_code_;
+    }
+
+    /// @brief Return last error message based on error code
+    const char* get_last_error_message() const
+    {
+        return sqlite3_errstr(current_return_code_);
+    }
+
+private:
+
+    using clock = std::chrono::steady_clock;
+
+    /// @brief Counters of one fingerprint, never removed until the profiler is destroyed
+    struct statement_entry
+    {
+        explicit statement_entry(std::string text) :
+            sql(std::move(text))
+        {
+        }
+
+        void record(uint64_t nanoseconds, uint64_t rows_returned, sqlite3_stmt* stmt)
+        {
+            histogram.record(nanoseconds);
+            rows.fetch_add(rows_returned, std::memory_order_relaxed);
+            fullscan_steps.fetch_add(static_cast<uint64_t>(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1)), std::memory_order_relaxed);
+            sorts.fetch_add(static_cast<uint64_t>(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1)), std::memory_order_relaxed);
+            autoindexes.fetch_add(static_cast<uint64_t>(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1)), std::memory_order_relaxed);
+            vm_steps.fetch_add(static_cast<uint64_t>(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1)), std::memory_order_relaxed);
+        }
+
+        void reset()
+        {
+            histogram.reset();
+            for (std::atomic<uint64_t>* counter : { &rows, &fullscan_steps, &sorts, &autoindexes, &vm_steps }) {
+                counter->store(0, std::memory_order_relaxed);
+            }
+        }
+
+        std::string sql;
+        sqlite3_latency_histogram histogram;
+        std::atomic<uint64_t> rows{ 0 };
+        std::atomic<uint64_t> fullscan_steps{ 0 };
+        std::atomic<uint64_t> sorts{ 0 };
+        std::atomic<uint64_t> autoindexes{ 0 };
+        std::atomic<uint64_t> vm_steps{ 0 };
+    };
+
+    /// @brief Hash table slot, claimed by hash first and published by entry pointer afterwards
+    struct slot
+    {
+        std::atomic<uint64_t> hash{ 0 };
+        std::atomic<statement_entry*> entry{ nullptr };
+    };
+
+    /// @brief FNV-1a of the fingerprint, never zero as zero marks a free slot
+    static uint64_t fingerprint_hash(const std::string& fingerprint)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (const char c : fingerprint) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        return (hash != 0) ? hash : 1;
+    }
+
+    /// @brief Wait until the slot claimed by another thread is published
+    static statement_entry* published_entry(const slot& target)
+    {
+        statement_entry* entry = nullptr;
+        while ((entry = target.entry.load(std::memory_order_acquire)) == nullptr) {
+            std::this_thread::yield();
+        }
+        return entry;
+    }
+
+    const statement_entry* find(const std::string& fingerprint, uint64_t hash) const
+    {
+        for (size_t probe = 0; probe <= mask_; ++probe) {
+            const slot& target = slots_[(hash + probe) & mask_];
+            const uint64_t slot_hash = target.hash.load(std::memory_order_acquire);
+            if (slot_hash == 0) {
+                return nullptr;
+            }
+            if (slot_hash == hash) {
+                const statement_entry* entry = published_entry(target);
+                if (entry->sql == fingerprint) {
+                    return entry;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    /// @brief Find counters of the fingerprint, registering it on the first run
+    statement_entry& entry_of(const std::string& fingerprint)
+    {
+        const uint64_t hash = fingerprint_hash(fingerprint);
+        for (size_t probe = 0; probe <= mask_; ++probe) {
+            slot& target = slots_[(hash + probe) & mask_];
+            uint64_t slot_hash = target.hash.load(std::memory_order_acquire);
+            if (slot_hash == 0) {
+                if (registered_.load(std::memory_order_relaxed) >= options_.max_statements) {
+                    break;
+                }
+                if (target.hash.compare_exchange_strong(slot_hash, hash, std::memory_order_acq_rel)) {
+                    registered_.fetch_add(1, std::memory_order_relaxed);
+                    statement_entry* entry = new statement_entry(fingerprint);
+                    target.entry.store(entry, std::memory_order_release);
+                    return *entry;
+                }
+            }
+            if (slot_hash == hash) {
+                statement_entry* entry = published_entry(target);
+                if (entry->sql == fingerprint) {
+                    return *entry;
+                }
+            }
+        }
+        return overflow_;
+    }
+
+    static sqlite3_latency_snapshot make_snapshot(const statement_entry& entry)
+    {
+        sqlite3_latency_snapshot snapshot;
+        snapshot.sql = entry.sql;
+        snapshot.count = entry.histogram.count();
+        snapshot.total = std::chrono::nanoseconds(entry.histogram.total());
+        snapshot.max = std::chrono::nanoseconds(entry.histogram.max());
+        const std::vector<uint64_t> values = entry.histogram.percentiles({ 0.5, 0.99, 0.999 });
+        snapshot.p50 = std::chrono::nanoseconds(values[0]);
+        snapshot.p99 = std::chrono::nanoseconds(values[1]);
+        snapshot.p999 = std::chrono::nanoseconds(values[2]);
+        snapshot.rows = entry.rows.load(std::memory_order_relaxed);
+        snapshot.fullscan_steps = entry.fullscan_steps.load(std::memory_order_relaxed);
+        snapshot.sorts = entry.sorts.load(std::memory_order_relaxed);
+        snapshot.autoindexes = entry.autoindexes.load(std::memory_order_relaxed);
+        snapshot.vm_steps = entry.vm_steps.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    static uint64_t order_key(const sqlite3_latency_snapshot& statement, sqlite3_profile_order order)
+    {
+        switch (order) {
+        case sqlite3_profile_order::calls:
+            return statement.count;
+        case sqlite3_profile_order::rows:
+            return statement.rows;
+        case sqlite3_profile_order::fullscan_steps:
+            return statement.fullscan_steps;
+        case sqlite3_profile_order::vm_steps:
+            return statement.vm_steps;
+        default:
+            return static_cast<uint64_t>(statement.total.count());
+        }
+    }
+
+    /// @brief Statements running on the current thread with their start time and rows returned,
+    /// a few at most as statements on one thread only nest while iterating
+    class running_statements
+    {
+    public:
+
+        void start(sqlite3_stmt* stmt)
+        {
+            const clock::time_point now = clock::now();
+            for (running& entry : running_) {
+                if (entry.stmt == stmt) {
+                    entry.started = now;
+                    entry.rows = 0;
+                    return;
+                }
+            }
+            if (running_.size() >= max_running) {
+                // Statements finished without PROFILE event, e.g. when the profiler was replaced
+                running_.erase(running_.begin());
+            }
+            running_.push_back(running{ stmt, now, 0 });
+        }
+
+        void row(sqlite3_stmt* stmt)
+        {
+            for (size_t i = running_.size(); i > 0; --i) {
+                if (running_[i - 1].stmt == stmt) {
+                    ++running_[i - 1].rows;
+                    return;
+                }
+            }
+        }
+
+        /// @param elapsed: replaced by the measured time if the statement was started on this thread
+        /// @return: rows returned
+        uint64_t finish(sqlite3_stmt* stmt, sqlite3_int64& elapsed)
+        {
+            for (size_t i = running_.size(); i > 0; --i) {
+                if (running_[i - 1].stmt == stmt) {
+                    elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - running_[i - 1].started).count();
+                    const uint64_t rows = running_[i - 1].rows;
+                    running_.erase(running_.begin() + static_cast<std::ptrdiff_t>(i - 1));
+                    return rows;
+                }
+            }
+            return 0;
+        }
+
+    private:
+
+        static constexpr size_t max_running = 64;
+
+        struct running
+        {
+            sqlite3_stmt* stmt;
+            clock::time_point started;
+            uint64_t rows;
+        };
+
+        std::vector<running> running_;
+    };
+
+    /// @brief Counters of recently finished statements on the current thread, so a prepared statement
+    /// run again is not fingerprinted and looked up again. Direct-mapped by statement pointer;
+    /// the SQL text is compared as well, as a finalized statement's address may be reused
+    class entry_cache
+    {
+    public:
+
+        statement_entry* find(uint64_t profiler, sqlite3_stmt* stmt, const char* sql) const
+        {
+            const cached& target = cached_[index(stmt)];
+            return (target.profiler == profiler && target.stmt == stmt && target.sql == sql) ? target.entry : nullptr;
+        }
+
+        void store(uint64_t profiler, sqlite3_stmt* stmt, const char* sql, statement_entry* entry)
+        {
+            cached& target = cached_[index(stmt)];
+            target.profiler = profiler;
+            target.stmt = stmt;
+            target.sql = sql;
+            target.entry = entry;
+        }
+
+    private:
+
+        static constexpr size_t size = 64;
+
+        struct cached
+        {
+            uint64_t profiler = 0;
+            sqlite3_stmt* stmt = nullptr;
+            std::string sql;
+            statement_entry* entry = nullptr;
+        };
+
+        static size_t index(sqlite3_stmt* stmt)
+        {
+            return (reinterpret_cast<uintptr_t>(stmt) >> 4) % size;
+        }
+
+        cached cached_[size];
+    };
+
+    /// @brief Per-thread state of the trace callback, buffers are reused between statements
+    struct thread_context
+    {
+        running_statements statements;
+        entry_cache entries;
+        std::string fingerprint;
+        std::vector<sqlite3_sql_fingerprint::token> tokens;
+    };
+
+    static thread_context& current_thread()
+    {
+        thread_local thread_context context;
+        return context;
+    }
+
+    /// @brief Called by SQLite on the thread running the statement
+    static int trace_callback(unsigned event, void* context, void* statement, void* detail)
+    {
+        sqlite3_profiler* profiler = static_cast<sqlite3_profiler*>(context);
+        sqlite3_stmt* stmt = static_cast<sqlite3_stmt*>(statement);
+        thread_context& thread = current_thread();
+        if (event == SQLITE_TRACE_ROW) {
+            thread.statements.row(stmt);
+            return 0;
+        }
+        if (event == SQLITE_TRACE_STMT) {
+            // Trigger programs are reported as "-- comment" lines, only top-level statements are timed
+            const char* text = static_cast<const char*>(detail);
+            if (text == nullptr || text[0] != '-' || text[1] != '-') {
+                profiler->statements_started_.fetch_add(1, std::memory_order_relaxed);
+                thread.statements.start(stmt);
+            }
+            return 0;
+        }
+        if (event != SQLITE_TRACE_PROFILE) {
+            return 0;
+        }
+
+        // Fall back to the time measured by SQLite if the statement was started on another thread
+        sqlite3_int64 elapsed = *static_cast<const sqlite3_int64*>(detail);
+        const uint64_t rows = thread.statements.finish(stmt, elapsed);
+        const char* sql = sqlite3_sql(stmt);
+        if (sql == nullptr) {
+            sql = "";
+        }
+        statement_entry* entry = thread.entries.find(profiler->id_, stmt, sql);
+        if (entry == nullptr) {
+            sqlite3_sql_fingerprint::make(sql, thread.fingerprint, thread.tokens);
+            entry = &profiler->entry_of(thread.fingerprint);
+            thread.entries.store(profiler->id_, stmt, sql, entry);
+        }
+        entry->record(static_cast<uint64_t>(elapsed), rows, stmt);
+
+        const auto threshold = profiler->options_.slow_query_threshold.count();
+        if (threshold > 0 && elapsed >= threshold) {
+            profiler->slow_queries_.fetch_add(1, std::memory_order_relaxed);
+            profiler->log_slow_query(stmt, elapsed);
+        }
+        return 0;
+    }
+
+    /// @brief Unique profiler identity for entry_cache, an address may be reused by the next profiler
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> last{ 0 };
+        return last.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    void log_slow_query(sqlite3_stmt* stmt, sqlite3_int64 elapsed) const
+    {
+        char* expanded = sqlite3_expanded_sql(stmt);
+        const char* text = (expanded != nullptr) ? expanded : sqlite3_sql(stmt);
+        if (options_.slow_query_log) {
+            options_.slow_query_log(text, std::chrono::nanoseconds(elapsed));
+        }
+        else {
+            std::fprintf(stderr, "sqlite3 slow query (%.3f ms): %s\n", static_cast<double>(elapsed) / 1e6, text);
+        }
+        sqlite3_free(expanded);
+    }
+
+    /// Profiled connection, not owned
+    sqlite3_helper& db_;
+
+    sqlite3_profiler_options options_;
+
+    /// Key of entry_cache
+    const uint64_t id_;
+
+    /// Open-addressing table, twice larger than max_statements
+    std::unique_ptr<slot[]> slots_;
+    size_t mask_ = 0;
+    std::atomic<size_t> registered_{ 0 };
+
+    /// Fingerprints over max_statements
+    statement_entry overflow_;
+
+    std::atomic<uint64_t> statements_started_{ 0 };
+    std::atomic<uint64_t> slow_queries_{ 0 };
+
+    /// Error code of installing the trace callback
+    int current_return_code_ = SQLITE_OK;
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "sqlite3_helper.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief Settings of sqlite3_stats_sampler
+struct sqlite3_stats_sampler_options
+{
+    /// Time between samples
+    std::chrono::milliseconds interval = std::chrono::milliseconds(10000);
+
+    /// Prometheus text exposition file, e.g. for node_exporter textfile collector; empty to disable
+    std::string prometheus_file;
+
+    /// JSON file; empty to disable
+    std::string json_file;
+
+    /// Value of the "db" label of Prometheus metrics
+    std::string label = "main";
+};
+
+/// @brief Samples sqlite3_helper::statistics on a timer and writes them into local files
+/// Files are replaced through sqlite3_helper::write_file(), so readers never see partial content.
+/// The helper should outlive the sampler and be opened in serialized mode (default, or SQLITE_OPEN_FULLMUTEX),
+/// as counters are read from the background thread. As sqlite3_helper, it does not throw exceptions
+class sqlite3_stats_sampler
+{
+public:
+
+    /// @brief One exported value
+    struct metric
+    {
+        /// Name without prefix and suffix, used as JSON key
+        const char* name;
+        const char* help;
+
+        /// Monotonic counter or gauge
+        bool counter;
+        sqlite3_int64 value;
+    };
+
+    explicit sqlite3_stats_sampler(sqlite3_helper& db,
+        const sqlite3_stats_sampler_options& options = sqlite3_stats_sampler_options()) :
+        db_(db),
+        options_(options)
+    {
+        worker_ = std::thread(&sqlite3_stats_sampler::run, this);
+    }
+
+    /// @brief Stop sampling, files keep the last sample
+    ~sqlite3_stats_sampler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_one();
+        worker_.join();
+    }
+
+    sqlite3_stats_sampler(const sqlite3_stats_sampler&) = delete;
+    sqlite3_stats_sampler& operator=(const sqlite3_stats_sampler&) = delete;
+
+    /// @brief Take a sample and write the files now
+    /// Samples are serialized with the background thread, as both write through the same temporary files
+    /// @return: SQLite error code, SQLITE_CANTOPEN or SQLITE_IOERR if a file was not written
+    int sample()
+    {
+        std::lock_guard<std::mutex> sampling(sample_mutex_);
+        sqlite3_helper::statistics stats;
+        int return_code = sqlite3_helper::read_stats(db_.handle(), stats);
+        if (return_code == SQLITE_OK && !options_.prometheus_file.empty()) {
+            const std::string text = to_prometheus(stats, options_.label);
+            return_code = sqlite3_helper::write_file(options_.prometheus_file.c_str(), text.data(), text.size());
+        }
+        if (return_code == SQLITE_OK && !options_.json_file.empty()) {
+            const std::string text = to_json(stats);
+            return_code = sqlite3_helper::write_file(options_.json_file.c_str(), text.data(), text.size());
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_sample_ = stats;
+        ++samples_;
+        current_return_code_ = return_code;
+        return return_code;
+    }
+
+    /// @brief Counters of the last sample
+    sqlite3_helper::statistics get_last_sample() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return last_sample_;
+    }
+
+    /// @brief Number of samples taken
+    size_t get_sample_count() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return samples_;
+    }
+
+    /// @brief Counters as a flat list of named values
+    static std::vector<metric> metrics(const sqlite3_helper::statistics& stats)
+    {
+        return {
+            { "cache_hits", "Page cache hits", true, stats.cache_hit },
+            { "cache_misses", "Page cache misses", true, stats.cache_miss },
+            { "cache_writes", "Dirty pages written to the database file", true, stats.cache_write },
+            { "cache_spills", "Dirty pages written in the middle of a transaction, as the cache was full", true, stats.cache_spill },
+            { "cache_used_bytes", "Page cache memory used by the connection", false, stats.cache_used },
+            { "cache_used_shared_bytes", "Shared page cache memory divided between connections", false, stats.cache_used_shared },
+            { "lookaside_used_slots", "Lookaside slots in use", false, stats.lookaside_used.current },
+            { "lookaside_used_slots_highwater", "Lookaside slots in use, high-water mark", false, stats.lookaside_used.highwater },
+            { "lookaside_hits", "Allocations served from lookaside", true, stats.lookaside_hit },
+            { "lookaside_misses_size", "Allocations too large for a lookaside slot", true, stats.lookaside_miss_size },
+            { "lookaside_misses_full", "Allocations missed as all lookaside slots were in use", true, stats.lookaside_miss_full },
+            { "schema_used_bytes", "Memory used by database schemas", false, stats.schema_used },
+            { "statement_used_bytes", "Memory used by prepared statements", false, stats.statement_used },
+            { "memory_used_bytes", "Memory allocated by SQLite in the process", false, stats.memory_used.current },
+            { "memory_used_highwater_bytes", "Memory allocated by SQLite in the process, high-water mark", false, stats.memory_used.highwater },
+            { "malloc_count", "Outstanding SQLite allocations", false, stats.malloc_count.current },
+            { "malloc_count_highwater", "Outstanding SQLite allocations, high-water mark", false, stats.malloc_count.highwater },
+            { "malloc_size_highwater_bytes", "Largest allocation request", false, stats.malloc_size_highwater },
+            { "pagecache_used_pages", "Pages of SQLITE_CONFIG_PAGECACHE memory in use", false, stats.pagecache_used.current },
+            { "pagecache_used_highwater_pages", "Pages of SQLITE_CONFIG_PAGECACHE memory in use, high-water mark", false, stats.pagecache_used.highwater },
+            { "pagecache_overflow_bytes", "Page cache memory which did not fit into SQLITE_CONFIG_PAGECACHE", false, stats.pagecache_overflow.current },
+            { "pagecache_overflow_highwater_bytes", "Page cache overflow, high-water mark", false, stats.pagecache_overflow.highwater },
+            { "pagecache_size_highwater_bytes", "Largest page cache allocation request", false, stats.pagecache_size_highwater },
+        };
+    }
+
+    /// @brief Prometheus text exposition format, metrics are prefixed with sqlite_
+    static std::string to_prometheus(const sqlite3_helper::statistics& stats, const std::string& label)
+    {
+        std::string result;
+        for (const metric& value : metrics(stats)) {
+            const std::string name = std::string("sqlite_") + value.name + (value.counter ? "_total" : "");
+            result += "# HELP " + name + ' ' + value.help + '\n';
+            result += "# TYPE " + name + (value.counter ? " counter\n" : " gauge\n");
+            result += name + "{db=\"" + escape_label(label) + "\"} " + std::to_string(value.value) + '\n';
+        }
+        return result;
+    }
+
+    /// @brief Flat JSON object with the sample time in seconds since the epoch
+    static std::string to_json(const sqlite3_helper::statistics& stats)
+    {
+        const auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch());
+        std::string result = "{\n  \"timestamp\": " + std::to_string(now.count());
+        for (const metric& value : metrics(stats)) {
+            result += std::string(",\n  \"") + value.name + "\": " + std::to_string(value.value);
+        }
+        result += "\n}\n";
+        return result;
+    }
+
+    /// @brief Return error code of the last sample
+    int get_last_error() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return current_return_code_;
+    }
+
+    /// @brief Return last error message based on error code
+    const char* get_last_error_message() const
+    {
+        return sqlite3_errstr(get_last_error());
+    }
+
+private:
+
+    /// @brief Background thread loop, the first sample is taken immediately
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            lock.unlock();
+            sample();
+            lock.lock();
+            wakeup_.wait_for(lock, options_.interval, [this] { return stop_; });
+        }
+    }
+
+    static std::string escape_label(const std::string& label)
+    {
+        std::string result;
+        for (const char c : label) {
+            if (c == '\\' || c == '"') {
+                result.push_back('\\');
+                result.push_back(c);
+            }
+            else if (c == '\n') {
+                result += "\\n";
+            }
+            else {
+                result.push_back(c);
+            }
+        }
+        return result;
+    }
+
+    /// Sampled connection, not owned
+    sqlite3_helper& db_;
+
+    sqlite3_stats_sampler_options options_;
+
+    /// Held while a sample is taken and written
+    std::mutex sample_mutex_;
+
+    /// Guards the fields below
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    sqlite3_helper::statistics last_sample_;
+    size_t samples_ = 0;
+
+    /// Error code of the last sample
+    int current_return_code_ = SQLITE_OK;
+
+    /// Background sampling thread
+    std::thread worker_;
+};
@@ -0,0 +1,296 @@
+#pragma once
+
+#include "sqlite3_helper.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/// @brief Checkpoint triggers of sqlite3_wal_manager
+struct sqlite3_wal_checkpoint_options
+{
+    /// PASSIVE checkpoint when WAL grows over this number of pages
+    int checkpoint_pages = 1000;
+
+    /// Escalate to RESTART if WAL is still larger than this after PASSIVE checkpoint,
+    /// so that the next writer starts from the beginning of the WAL file.
+    /// RESTART and TRUNCATE hold the writer lock, so they are only run when writers are idle
+    int restart_pages = 4000;
+
+    /// Escalate to TRUNCATE if WAL is still larger than this, shrinking the file to zero bytes
+    int truncate_pages = 16000;
+
+    /// PASSIVE checkpoint of a non-empty WAL after writers were idle for this time
+    std::chrono::milliseconds idle_interval = std::chrono::milliseconds(500);
+
+    /// Busy timeout of the checkpoint connection, RESTART and TRUNCATE wait for readers and writers
+    int busy_timeout_ms = 100;
+};
+
+/// @brief Checkpoint counters of sqlite3_wal_manager
+struct sqlite3_wal_checkpoint_stats
+{
+    /// Checkpoints completed with SQLITE_OK by mode, escalation counts both PASSIVE and RESTART or TRUNCATE
+    size_t passive = 0;
+    size_t restart = 0;
+    size_t truncate = 0;
+
+    /// Checkpoints of any mode returned SQLITE_BUSY: RESTART and TRUNCATE blocked by readers or writers,
+    /// PASSIVE by another checkpoint running
+    size_t busy = 0;
+
+    /// Checkpoints returned error other than SQLITE_BUSY
+    size_t failed = 0;
+
+    /// WAL frames and checkpointed frames after the last checkpoint
+    int last_log_frames = 0;
+    int last_checkpointed_frames = 0;
+};
+
+/// @brief WAL mode manager moving checkpoints off the writer threads
+/// Switches the connection into WAL mode, disables auto-checkpoint and installs sqlite3_wal_hook(),
+/// which only records WAL size and wakes the background thread. The thread checkpoints
+/// through its own connection to the same file: PASSIVE when WAL size crosses the threshold
+/// or writers are idle, escalating to RESTART and TRUNCATE when WAL is still large and writers are idle.
+/// The helper should outlive the manager, destructor stops the thread and restores auto-checkpoint.
+/// As sqlite3_helper, it does not throw exceptions, check get_last_error() after construction
+class sqlite3_wal_manager
+{
+public:
+
+    explicit sqlite3_wal_manager(sqlite3_helper& db,
+        const sqlite3_wal_checkpoint_options& options = sqlite3_wal_checkpoint_options()) :
+        db_(db),
+        options_(options)
+    {
+        if ((current_return_code_ = db_.set_journal_mode("WAL")) != SQLITE_OK) {
+            return;
+        }
+
+        const char* filename = sqlite3_db_filename(db_.handle(), "main");
+        sqlite3_helper::open_options checkpoint_options;
+        checkpoint_options.flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX;
+        checkpoint_options.busy_timeout = options_.busy_timeout_ms;
+        if ((current_return_code_ = checkpointer_.open(filename, checkpoint_options)) != SQLITE_OK) {
+            return;
+        }
+        // Checkpoint connection must not checkpoint on its own either,
+        // and it should read the database header once to notice WAL mode
+        sqlite3_wal_autocheckpoint(checkpointer_.handle(), 0);
+        if (checkpointer_.get_journal_mode() != "wal") {
+            current_return_code_ = (checkpointer_.get_last_error() != SQLITE_OK) ? checkpointer_.get_last_error() : SQLITE_ERROR;
+            return;
+        }
+
+        last_commit_ = clock::now();
+        sqlite3_wal_hook(db_.handle(), &sqlite3_wal_manager::wal_hook, this);
+        worker_ = std::thread(&sqlite3_wal_manager::run, this);
+    }
+
+    /// @brief Stop background thread and restore default auto-checkpoint of the connection
+    ~sqlite3_wal_manager()
+    {
+        if (worker_.joinable()) {
+            sqlite3_wal_hook(db_.handle(), nullptr, nullptr);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wakeup_.notify_one();
+            worker_.join();
+            sqlite3_wal_autocheckpoint(db_.handle(), default_autocheckpoint_pages);
+        }
+    }
+
+    sqlite3_wal_manager(const sqlite3_wal_manager&) = delete;
+    sqlite3_wal_manager& operator=(const sqlite3_wal_manager&) = delete;
+
+    /// @brief Request checkpoint now, without waiting for the thresholds
+    void request_checkpoint()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            requested_ = true;
+        }
+        wakeup_.notify_one();
+    }
+
+    /// @brief WAL size in pages reported by the last commit
+    int get_wal_pages() const
+    {
+        return wal_pages_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Return checkpoint counters
+    sqlite3_wal_checkpoint_stats get_stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    /// @brief Is WAL enabled and the checkpoint thread running
+    operator bool() const
+    {
+        return is_valid();
+    }
+
+    /// @brief Is WAL enabled and the checkpoint thread running
+    bool is_valid() const
+    {
+        return worker_.joinable();
+    }
+
+    /// @brief Return error code of enabling WAL or opening the checkpoint connection
+    int get_last_error() const
+    {
+        return current_return_code_;
+    }
+
+    /// @brief Return last error message based on error code
+    const char* get_last_error_message() const
+    {
+        return sqlite3_errstr(current_return_code_);
+    }
+
+private:
+
+    using clock = std::chrono::steady_clock;
+
+    /// SQLITE_DEFAULT_WAL_AUTOCHECKPOINT of the default build
+    static constexpr int default_autocheckpoint_pages = 1000;
+
+    /// @brief Called by SQLite on the writer thread after each commit, must stay cheap
+    static int wal_hook(void* context, sqlite3*, const char*, int pages)
+    {
+        sqlite3_wal_manager* manager = static_cast<sqlite3_wal_manager*>(context);
+        manager->wal_pages_.store(pages, std::memory_order_relaxed);
+        manager->commits_.fetch_add(1, std::memory_order_relaxed);
+        if (pages >= manager->options_.checkpoint_pages) {
+            manager->wakeup_.notify_one();
+        }
+        return SQLITE_OK;
+    }
+
+    /// @brief Background thread loop
+    void run()
+    {
+        size_t seen_commits = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            wakeup_.wait_for(lock, options_.idle_interval);
+            if (stop_) {
+                break;
+            }
+
+            const int pages = wal_pages_.load(std::memory_order_relaxed);
+            const size_t commits = commits_.load(std::memory_order_relaxed);
+            const auto now = clock::now();
+            if (commits != seen_commits) {
+                seen_commits = commits;
+                last_commit_ = now;
+            }
+
+            // WAL grew by the threshold since the last checkpoint, or was restarted by a writer and grew again
+            const bool over_threshold = (pages >= options_.checkpoint_pages) &&
+                (pages < checkpointed_pages_ || pages - checkpointed_pages_ >= options_.checkpoint_pages);
+            const bool idle = (pages > 0) && (now - last_commit_ >= options_.idle_interval);
+            if (!over_threshold && !idle && !requested_) {
+                continue;
+            }
+            requested_ = false;
+
+            lock.unlock();
+            checkpoint(pages, idle);
+            lock.lock();
+        }
+    }
+
+    /// @brief PASSIVE checkpoint, escalating while WAL stays large
+    /// @param pages: WAL size which triggered the checkpoint
+    /// @param idle: no commits during the idle interval, escalation would not block writers
+    void checkpoint(int pages, bool idle)
+    {
+        int log_frames = 0;
+        int checkpointed_frames = 0;
+        int mode = SQLITE_CHECKPOINT_PASSIVE;
+        int return_code = run_checkpoint(mode, log_frames, checkpointed_frames);
+        checkpointed_pages_ = pages;
+
+        if (return_code == SQLITE_OK && idle && log_frames >= options_.restart_pages) {
+            mode = (log_frames >= options_.truncate_pages) ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_RESTART;
+            return_code = run_checkpoint(mode, log_frames, checkpointed_frames);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (return_code != SQLITE_OK && return_code != SQLITE_BUSY) {
+            return;
+        }
+        stats_.last_log_frames = log_frames;
+        stats_.last_checkpointed_frames = checkpointed_frames;
+        const bool complete = (return_code == SQLITE_OK) && (checkpointed_frames == log_frames);
+        if (complete && (mode != SQLITE_CHECKPOINT_PASSIVE || log_frames < options_.restart_pages)) {
+            // Everything is copied into the database and WAL is small, nothing to do until the next commit
+            wal_pages_.compare_exchange_strong(pages, 0, std::memory_order_relaxed);
+            checkpointed_pages_ = 0;
+        }
+    }
+
+    /// @brief Run one checkpoint and count it by mode and result
+    /// @return: SQLite error code
+    int run_checkpoint(int mode, int& log_frames, int& checkpointed_frames)
+    {
+        const int return_code = sqlite3_wal_checkpoint_v2(checkpointer_.handle(), nullptr,
+            mode, &log_frames, &checkpointed_frames);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (return_code == SQLITE_BUSY) {
+            ++stats_.busy;
+        }
+        else if (return_code != SQLITE_OK) {
+            ++stats_.failed;
+        }
+        else if (mode == SQLITE_CHECKPOINT_PASSIVE) {
+            ++stats_.passive;
+        }
+        else if (mode == SQLITE_CHECKPOINT_RESTART) {
+            ++stats_.restart;
+        }
+        else {
+            ++stats_.truncate;
+        }
+        return return_code;
+    }
+
+    /// Managed connection, not owned
+    sqlite3_helper& db_;
+
+    /// Checkpoint triggers
+    sqlite3_wal_checkpoint_options options_;
+
+    /// Dedicated connection used by the background thread
+    sqlite3_helper checkpointer_;
+
+    /// WAL size reported by the last commit
+    std::atomic<int> wal_pages_{ 0 };
+
+    /// Commits seen by the WAL hook
+    std::atomic<size_t> commits_{ 0 };
+
+    /// WAL size at the last checkpoint, used by the background thread only
+    int checkpointed_pages_ = 0;
+
+    /// Guards the fields below
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    bool requested_ = false;
+    clock::time_point last_commit_;
+    sqlite3_wal_checkpoint_stats stats_;
+
+    /// Background checkpoint thread
+    std::thread worker_;
+
+    /// Error code of enabling WAL or opening the checkpoint connection
+    int current_return_code_ = SQLITE_OK;
+};